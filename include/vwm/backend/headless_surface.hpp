@@ -0,0 +1,97 @@
+///////////////////////////////////////////////////////////////////////////////
+//
+// Copyright 2019 Felipe Magno de Almeida.
+// Distributed under the Boost Software License, Version 1.0. (See
+// accompanying file LICENSE_1_0.txt or copy at
+// http://www.boost.org/LICENSE_1_0.txt)
+// See http://www.boost.org/libs/foreach for documentation
+//
+
+#ifndef VWM_BACKEND_HEADLESS_SURFACE_HPP
+#define VWM_BACKEND_HEADLESS_SURFACE_HPP
+
+#include <vwm/uv/detail/timer.hpp>
+
+#include <fastdraw/output/vulkan/add_image.hpp>
+
+#include <vulkan/vulkan.h>
+#include <uv.h>
+
+#include <algorithm>
+#include <chrono>
+#include <system_error>
+#include <vector>
+#include <cstdint>
+
+namespace vwm { namespace backend { namespace headless {
+
+// Windowing base for ftk's vulkan backend without a display server.
+// The swapchain comes from a VK_EXT_headless_surface, so presenting
+// never blocks on a real vblank, a uv timer ticking at the configured
+// refresh stands in for it. Works with any driver implementing the
+// extension, lavapipe included
+template <typename Loop>
+struct surface : Loop
+{
+  surface (Loop loop)
+    : Loop (loop) {}
+
+  static std::vector<char const*> instance_extensions ()
+  {
+    return {VK_KHR_SURFACE_EXTENSION_NAME, VK_EXT_HEADLESS_SURFACE_EXTENSION_NAME};
+  }
+
+  // a headless surface has no size of its own, the swapchain takes
+  // the size the window is created with
+  VkSurfaceKHR create_surface (VkInstance instance) const
+  {
+    using fastdraw::output::vulkan::from_result;
+    using fastdraw::output::vulkan::vulkan_error_code;
+
+    auto const create = reinterpret_cast<PFN_vkCreateHeadlessSurfaceEXT>
+      (vkGetInstanceProcAddr (instance, "vkCreateHeadlessSurfaceEXT"));
+    if (!create)
+      throw std::system_error (make_error_code (from_result (VK_ERROR_EXTENSION_NOT_PRESENT)));
+
+    VkHeadlessSurfaceCreateInfoEXT info = {};
+    info.sType = VK_STRUCTURE_TYPE_HEADLESS_SURFACE_CREATE_INFO_EXT;
+    VkSurfaceKHR surface;
+    auto r = from_result (create (instance, &info, nullptr, &surface));
+    if (r != vulkan_error_code::success)
+      throw std::system_error (make_error_code (r));
+    return surface;
+  }
+
+  // calls tick with the tick count and the timer once per refresh, in
+  // the loop thread, until the timer is stopped. uv timers count whole
+  // milliseconds, so every tick is rescheduled from when it was due
+  // in nanoseconds and the rounding does not add up
+  template <typename F>
+  void start_ticks (std::chrono::nanoseconds refresh, F tick) const
+  {
+    auto const interval = std::max<std::uint64_t> (1, refresh.count());
+    auto const milliseconds = [] (std::uint64_t nanoseconds)
+                              {
+                                return (nanoseconds + 999999) / 1000000;
+                              };
+    vwm::ui::detail::timer_wait (this->loop, milliseconds (interval), milliseconds (interval)
+                                 , [tick, interval, milliseconds, start = ::uv_hrtime()
+                                    , ticks = std::uint64_t (0)] (uv_timer_t* timer) mutable
+                                   {
+                                     tick (++ticks, timer);
+                                     if (!::uv_is_active (reinterpret_cast<uv_handle_t*>(timer)))
+                                       return;
+                                     // uv_timer_again rearms it from now, a repeat of 0
+                                     // would stop it
+                                     auto const due = start + (ticks + 1) * interval;
+                                     auto const now = ::uv_hrtime();
+                                     ::uv_timer_set_repeat
+                                       (timer, std::max<std::uint64_t> (1, due > now ? milliseconds (due - now) : 0));
+                                     ::uv_timer_again (timer);
+                                   });
+  }
+};
+
+} } }
+
+#endif
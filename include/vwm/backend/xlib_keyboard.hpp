@@ -10,6 +10,8 @@
 #ifndef VWM_BACKEND_KEYBOARD_HPP
 #define VWM_BACKEND_KEYBOARD_HPP
 
+#include <vwm/log.hpp>
+
 #include <cassert>
 #include <xkbcommon/xkbcommon.h>
 
@@ -42,7 +44,7 @@ struct keyboard
   {
     xkb_state_update_mask (this->state, mods_depressed(), mods_latched(), mods_locked(), 0, 0, group());
     xkb_state_update_key (this->state, keycode, is_pressed ? XKB_KEY_DOWN : XKB_KEY_UP);
-    std::cout << "updated" << std::endl;
+    VWM_LOG (trace, input, "updated");
   }
   
   uint32_t mods_depressed () const
@@ -0,0 +1,181 @@
+///////////////////////////////////////////////////////////////////////////////
+//
+// Copyright 2019 Felipe Magno de Almeida.
+// Distributed under the Boost Software License, Version 1.0. (See
+// accompanying file LICENSE_1_0.txt or copy at
+// http://www.boost.org/LICENSE_1_0.txt)
+// See http://www.boost.org/libs/foreach for documentation
+//
+
+#ifndef VWM_CURSOR_LAYER_HPP
+#define VWM_CURSOR_LAYER_HPP
+
+#include <vwm/presentation_feedback.hpp>
+#include <vwm/scene_gate.hpp>
+#include <vwm/motion_history.hpp>
+
+#include <ftk/ui/toplevel_window.hpp>
+
+#include <uv.h>
+
+#include <functional>
+#include <iterator>
+#include <cstdint>
+
+namespace vwm {
+
+// The pointer image as the topmost toplevel component. Motion only
+// records the position, the component is moved once per loop iteration
+// before the loop blocks, so a burst of motion events costs one move
+// and one scene, and the damage is just the old and new cursor rects.
+// With presentation feedback, a move also waits for the frame drawing
+// the previous one to be presented, so there is at most one cursor
+// move per output frame. A move that finds the scene gate held waits
+// for the gate's dispatch instead of the frames in use
+template <typename Toplevel>
+struct cursor_layer
+{
+  typedef decltype (std::declval<Toplevel&>().components.end()) component_iterator;
+
+  cursor_layer (uv_loop_t* loop, Toplevel& toplevel, VkImageView image
+                , std::int32_t width, std::int32_t height, std::function<std::uint64_t()> render_dirty
+                , presentation_feedback* feedback = nullptr, scene_gate* gate = nullptr
+                , std::size_t history_size = 0)
+    : toplevel (&toplevel), image (image), width (width), height (height)
+    , render_dirty (std::move (render_dirty)), component (toplevel.components.end())
+    , feedback (feedback), gate (gate), history (history_size)
+  {
+    ::uv_prepare_init (loop, &prepare);
+    prepare.data = this;
+    if (feedback)
+      feedback_connection = feedback->connect
+        ([this] (presented_frame const& frame) { presented (frame.scene); });
+    if (gate)
+      gate_connection = gate->connect
+        ([this]
+         {
+           if (moved && !throttled())
+             apply_move ();
+         });
+  }
+
+  ~cursor_layer ()
+  {
+    ::uv_prepare_stop (&prepare);
+    if (feedback)
+      feedback->disconnect (feedback_connection);
+    if (gate)
+      gate->disconnect (gate_connection);
+  }
+
+  cursor_layer (cursor_layer const&) = delete;
+  cursor_layer& operator= (cursor_layer const&) = delete;
+
+  // before the layer is destroyed, the loop no longer calls update
+  // through the prepare handle
+  void close ()
+  {
+    ::uv_prepare_stop (&prepare);
+    ::uv_close (reinterpret_cast<uv_handle_t*>(&prepare), nullptr);
+  }
+
+  // time of the motion event, in milliseconds
+  void move (std::uint32_t time, std::int32_t x, std::int32_t y)
+  {
+    history.record (time, x, y);
+    this->x = x;
+    this->y = y;
+    moved = true;
+    schedule ();
+  }
+
+  // components appended after the cursor would be drawn over it, must
+  // be called before a scene is built from the toplevel, with the gate
+  // held
+  void keep_on_top ()
+  {
+    if (component != toplevel->components.end()
+        && std::next (component) != toplevel->components.end())
+    {
+      toplevel->remove_component (component);
+      component = toplevel->append_component
+        ({x, y, width, height, ftk::ui::image_component{image}});
+    }
+  }
+
+  // deltas of every motion, including the ones coalesced into a single
+  // move, for consumers such as pointer acceleration or relative
+  // pointer events. Records nothing unless history_size was given
+  motion_history& motions () { return history; }
+
+private:
+  bool throttled () const
+  {
+    return feedback && in_flight > last_presented;
+  }
+
+  void schedule ()
+  {
+    if (moved && !scheduled && !throttled())
+    {
+      scheduled = true;
+      ::uv_prepare_start (&prepare, [] (uv_prepare_t* handle)
+                                    {
+                                      static_cast<cursor_layer*>(handle->data)->update();
+                                    });
+    }
+  }
+
+  void update ()
+  {
+    ::uv_prepare_stop (&prepare);
+    scheduled = false;
+
+    if (!gate)
+      apply_move ();
+    else if (gate->try_lock ())
+    {
+      std::unique_lock<scene_gate> changing (*gate, std::adopt_lock);
+      apply_move ();
+    }
+  }
+
+  // with the gate held
+  void apply_move ()
+  {
+    moved = false;
+    if (component == toplevel->components.end())
+      component = toplevel->append_component
+        ({x, y, width, height, ftk::ui::image_component{image}});
+    else
+      toplevel->move_component (component, x, y);
+    in_flight = render_dirty();
+  }
+
+  void presented (std::uint64_t scene)
+  {
+    last_presented = scene;
+    schedule ();
+  }
+
+  Toplevel* toplevel;
+  VkImageView image;
+  std::int32_t width, height;
+  std::int32_t x = 0, y = 0;
+  std::function<std::uint64_t()> render_dirty;
+  component_iterator component;
+  presentation_feedback* feedback;
+  presentation_feedback::connection feedback_connection;
+  scene_gate* gate;
+  scene_gate::connection gate_connection;
+  motion_history history;
+  // scene of the last move and last scene presented, every scene is
+  // drawn by a frame that is reported, so a move is never held forever
+  std::uint64_t in_flight = 0, last_presented = 0;
+  bool moved = false, scheduled = false;
+  uv_prepare_t prepare;
+};
+
+}
+
+#endif
@@ -0,0 +1,66 @@
+///////////////////////////////////////////////////////////////////////////////
+//
+// Copyright 2019 Felipe Magno de Almeida.
+// Distributed under the Boost Software License, Version 1.0. (See
+// accompanying file LICENSE_1_0.txt or copy at
+// http://www.boost.org/LICENSE_1_0.txt)
+// See http://www.boost.org/libs/foreach for documentation
+//
+
+#ifndef VWM_DAMAGE_HISTORY_HPP
+#define VWM_DAMAGE_HISTORY_HPP
+
+#include <vwm/region.hpp>
+
+#include <deque>
+#include <vector>
+#include <cstdint>
+
+namespace vwm {
+
+// Damage of the last frames kept as a ring, so an acquired swapchain
+// image is repainted with the union of everything that changed since
+// the frame it holds, whatever order the presentation engine hands
+// images back in
+struct damage_history
+{
+  damage_history (std::size_t image_count, std::size_t capacity)
+    : image_frames (image_count, 0u), capacity (capacity)
+  {
+  }
+
+  // Records new_damage as the damage of a new frame rendered to image
+  // and returns the region that image must repaint. Images that were
+  // never rendered, or that are older than the history, are repainted
+  // whole
+  region frame_damage (std::uint32_t image, region const& new_damage, rect extents)
+  {
+    ++frame;
+    damages.push_front (new_damage);
+    if (damages.size() > capacity)
+      damages.pop_back();
+
+    auto const image_frame = image_frames[image];
+    image_frames[image] = frame;
+
+    auto const age = frame - image_frame;
+    if (image_frame == 0 || age > damages.size())
+      return region (extents);
+
+    region repaint;
+    for (std::size_t i = 0; i != age; ++i)
+      repaint.unite (damages[i]);
+    return repaint;
+  }
+
+private:
+  std::uint64_t frame = 0;
+  // frame whose content each swapchain image holds, 0 when none
+  std::vector<std::uint64_t> image_frames;
+  std::deque<region> damages;
+  std::size_t capacity;
+};
+
+}
+
+#endif
@@ -0,0 +1,310 @@
+///////////////////////////////////////////////////////////////////////////////
+//
+// Copyright 2019 Felipe Magno de Almeida.
+// Distributed under the Boost Software License, Version 1.0. (See
+// accompanying file LICENSE_1_0.txt or copy at
+// http://www.boost.org/LICENSE_1_0.txt)
+// See http://www.boost.org/libs/foreach for documentation
+//
+
+#ifndef VWM_FRAME_READBACK_HPP
+#define VWM_FRAME_READBACK_HPP
+
+#include <fastdraw/output/vulkan/add_image.hpp>
+
+#include <vulkan/vulkan.h>
+#include <png.h>
+
+#include <filesystem>
+#include <stdexcept>
+#include <system_error>
+#include <vector>
+#include <cerrno>
+#include <cstdio>
+#include <cstdint>
+
+namespace vwm {
+
+namespace detail {
+
+inline std::uint32_t frame_readback_memory_type (VkPhysicalDevice physical_device, std::uint32_t type_bits
+                                                 , VkMemoryPropertyFlags flags)
+{
+  VkPhysicalDeviceMemoryProperties properties;
+  vkGetPhysicalDeviceMemoryProperties (physical_device, &properties);
+  for (std::uint32_t i = 0; i != properties.memoryTypeCount; ++i)
+    if ((type_bits & (1u << i)) && (properties.memoryTypes[i].propertyFlags & flags) == flags)
+      return i;
+  throw std::system_error (make_error_code (fastdraw::output::vulkan::from_result
+                                            (VK_ERROR_FEATURE_NOT_PRESENT)));
+}
+
+inline VkDeviceMemory frame_readback_allocate (VkDevice device, VkPhysicalDevice physical_device
+                                              , VkMemoryRequirements const& requirements
+                                              , VkMemoryPropertyFlags flags)
+{
+  using fastdraw::output::vulkan::from_result;
+  using fastdraw::output::vulkan::vulkan_error_code;
+
+  VkMemoryAllocateInfo allocate_info = {VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_INFO};
+  allocate_info.allocationSize = requirements.size;
+  allocate_info.memoryTypeIndex = frame_readback_memory_type (physical_device, requirements.memoryTypeBits, flags);
+  VkDeviceMemory memory;
+  auto r = from_result (vkAllocateMemory (device, &allocate_info, nullptr, &memory));
+  if (r != vulkan_error_code::success)
+    throw std::system_error (make_error_code (r));
+  return memory;
+}
+
+inline void frame_readback_image_barrier (VkCommandBuffer command_buffer, VkImage image
+                                          , VkImageLayout old_layout, VkImageLayout new_layout
+                                          , VkAccessFlags src_access, VkAccessFlags dst_access
+                                          , VkPipelineStageFlags src_stage, VkPipelineStageFlags dst_stage)
+{
+  VkImageMemoryBarrier barrier = {VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER};
+  barrier.srcAccessMask = src_access;
+  barrier.dstAccessMask = dst_access;
+  barrier.oldLayout = old_layout;
+  barrier.newLayout = new_layout;
+  barrier.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+  barrier.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+  barrier.image = image;
+  barrier.subresourceRange = {VK_IMAGE_ASPECT_COLOR_BIT, 0, 1, 0, 1};
+  vkCmdPipelineBarrier (command_buffer, src_stage, dst_stage, 0, 0, nullptr, 0, nullptr, 1, &barrier);
+}
+
+}
+
+// Composes a frame a second time into an image owned by vwm, copies it
+// to host memory and writes it as a PNG. The backend creates the
+// swapchain images without VK_IMAGE_USAGE_TRANSFER_SRC_BIT, so they are
+// never copied from. The image has the swapchain format and extent, so
+// the composition render pass draws into its framebuffer. Only 4 bytes
+// per pixel UNORM/SRGB formats are supported
+struct frame_readback
+{
+  // throws when the format is not one written as PNG, before any frame
+  // is rendered
+  static void check_format (VkFormat format)
+  {
+    if (format != VK_FORMAT_B8G8R8A8_UNORM && format != VK_FORMAT_B8G8R8A8_SRGB
+        && format != VK_FORMAT_R8G8B8A8_UNORM && format != VK_FORMAT_R8G8B8A8_SRGB)
+      throw std::runtime_error ("frame readback: the swapchain format is not 8 bit RGBA or BGRA");
+  }
+
+  // render_pass is the composition render pass, its framebuffer for
+  // the image is created here
+  frame_readback (VkDevice device, VkPhysicalDevice physical_device, VkExtent2D extent, VkFormat format
+                  , VkRenderPass render_pass)
+    : device (device), extent (extent), format (format)
+  {
+    try
+    {
+      create_image (physical_device, render_pass);
+      create_buffer (physical_device);
+    }
+    catch (...)
+    {
+      destroy ();
+      throw;
+    }
+  }
+
+  ~frame_readback ()
+  {
+    destroy ();
+  }
+
+  frame_readback (frame_readback const&) = delete;
+  frame_readback& operator= (frame_readback const&) = delete;
+
+  VkFramebuffer framebuffer () const { return image_framebuffer; }
+
+  // before the composition passes, clears the image and puts it in
+  // VK_IMAGE_LAYOUT_PRESENT_SRC_KHR, the layout the render pass takes
+  // the swapchain images in
+  void prepare (VkCommandBuffer command_buffer) const
+  {
+    detail::frame_readback_image_barrier
+      (command_buffer, image, VK_IMAGE_LAYOUT_UNDEFINED, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL
+       , 0, VK_ACCESS_TRANSFER_WRITE_BIT
+       , VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT, VK_PIPELINE_STAGE_TRANSFER_BIT);
+    VkClearColorValue const black = {};
+    VkImageSubresourceRange const range = {VK_IMAGE_ASPECT_COLOR_BIT, 0, 1, 0, 1};
+    vkCmdClearColorImage (command_buffer, image, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, &black, 1, &range);
+    detail::frame_readback_image_barrier
+      (command_buffer, image, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, VK_IMAGE_LAYOUT_PRESENT_SRC_KHR
+       , VK_ACCESS_TRANSFER_WRITE_BIT
+       , VK_ACCESS_COLOR_ATTACHMENT_READ_BIT | VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT
+       , VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT);
+  }
+
+  // after the composition passes, which leave the image in
+  // VK_IMAGE_LAYOUT_PRESENT_SRC_KHR
+  void record (VkCommandBuffer command_buffer) const
+  {
+    detail::frame_readback_image_barrier
+      (command_buffer, image, VK_IMAGE_LAYOUT_PRESENT_SRC_KHR, VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL
+       , VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT, VK_ACCESS_TRANSFER_READ_BIT
+       , VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT, VK_PIPELINE_STAGE_TRANSFER_BIT);
+
+    VkBufferImageCopy region = {};
+    region.imageSubresource = {VK_IMAGE_ASPECT_COLOR_BIT, 0, 0, 1};
+    region.imageExtent = {extent.width, extent.height, 1};
+    vkCmdCopyImageToBuffer (command_buffer, image, VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL
+                            , buffer, 1, &region);
+
+    VkBufferMemoryBarrier buffer_barrier = {VK_STRUCTURE_TYPE_BUFFER_MEMORY_BARRIER};
+    buffer_barrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+    buffer_barrier.dstAccessMask = VK_ACCESS_HOST_READ_BIT;
+    buffer_barrier.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+    buffer_barrier.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+    buffer_barrier.buffer = buffer;
+    buffer_barrier.size = VK_WHOLE_SIZE;
+    vkCmdPipelineBarrier (command_buffer, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_HOST_BIT
+                          , 0, 0, nullptr, 1, &buffer_barrier, 0, nullptr);
+  }
+
+  // after the fence of the submission with the recorded copy signaled
+  void write_png (std::filesystem::path const& path) const
+  {
+    using fastdraw::output::vulkan::from_result;
+    using fastdraw::output::vulkan::vulkan_error_code;
+
+    void* data;
+    auto r = from_result (vkMapMemory (device, memory, 0, VK_WHOLE_SIZE, 0, &data));
+    if (r != vulkan_error_code::success)
+      throw std::system_error (make_error_code (r));
+
+    std::vector<png_bytep> rows (extent.height);
+    for (std::uint32_t y = 0; y != extent.height; ++y)
+      rows[y] = static_cast<png_bytep>(data) + std::size_t (y) * extent.width * 4;
+
+    std::FILE* file = std::fopen (path.c_str(), "wb");
+    if (!file)
+    {
+      vkUnmapMemory (device, memory);
+      throw std::system_error (errno, std::generic_category());
+    }
+
+    png_structp png = png_create_write_struct (PNG_LIBPNG_VER_STRING, nullptr, nullptr, nullptr);
+    png_infop info = png ? png_create_info_struct (png) : nullptr;
+    if (!info || setjmp (png_jmpbuf (png)))
+    {
+      png_destroy_write_struct (&png, &info);
+      std::fclose (file);
+      vkUnmapMemory (device, memory);
+      throw std::system_error (std::make_error_code (std::errc::io_error));
+    }
+    png_init_io (png, file);
+    png_set_IHDR (png, info, extent.width, extent.height, 8, PNG_COLOR_TYPE_RGB_ALPHA
+                  , PNG_INTERLACE_NONE, PNG_COMPRESSION_TYPE_DEFAULT, PNG_FILTER_TYPE_DEFAULT);
+    png_write_info (png, info);
+    if (format == VK_FORMAT_B8G8R8A8_UNORM || format == VK_FORMAT_B8G8R8A8_SRGB)
+      png_set_bgr (png);
+    png_write_image (png, rows.data());
+    png_write_end (png, nullptr);
+    png_destroy_write_struct (&png, &info);
+    std::fclose (file);
+    vkUnmapMemory (device, memory);
+  }
+
+private:
+  void create_image (VkPhysicalDevice physical_device, VkRenderPass render_pass)
+  {
+    using fastdraw::output::vulkan::from_result;
+    using fastdraw::output::vulkan::vulkan_error_code;
+
+    VkImageCreateInfo image_info = {VK_STRUCTURE_TYPE_IMAGE_CREATE_INFO};
+    image_info.imageType = VK_IMAGE_TYPE_2D;
+    image_info.format = format;
+    image_info.extent = {extent.width, extent.height, 1};
+    image_info.mipLevels = 1;
+    image_info.arrayLayers = 1;
+    image_info.samples = VK_SAMPLE_COUNT_1_BIT;
+    image_info.tiling = VK_IMAGE_TILING_OPTIMAL;
+    image_info.usage = VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT | VK_IMAGE_USAGE_TRANSFER_SRC_BIT
+      | VK_IMAGE_USAGE_TRANSFER_DST_BIT;
+    image_info.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
+    image_info.initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+    auto r = from_result (vkCreateImage (device, &image_info, nullptr, &image));
+    if (r != vulkan_error_code::success)
+      throw std::system_error (make_error_code (r));
+
+    VkMemoryRequirements requirements;
+    vkGetImageMemoryRequirements (device, image, &requirements);
+    image_memory = detail::frame_readback_allocate (device, physical_device, requirements
+                                                    , VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT);
+    r = from_result (vkBindImageMemory (device, image, image_memory, 0));
+    if (r != vulkan_error_code::success)
+      throw std::system_error (make_error_code (r));
+
+    VkImageViewCreateInfo view_info = {VK_STRUCTURE_TYPE_IMAGE_VIEW_CREATE_INFO};
+    view_info.image = image;
+    view_info.viewType = VK_IMAGE_VIEW_TYPE_2D;
+    view_info.format = format;
+    view_info.subresourceRange = {VK_IMAGE_ASPECT_COLOR_BIT, 0, 1, 0, 1};
+    r = from_result (vkCreateImageView (device, &view_info, nullptr, &image_view));
+    if (r != vulkan_error_code::success)
+      throw std::system_error (make_error_code (r));
+
+    VkFramebufferCreateInfo framebuffer_info = {VK_STRUCTURE_TYPE_FRAMEBUFFER_CREATE_INFO};
+    framebuffer_info.renderPass = render_pass;
+    framebuffer_info.attachmentCount = 1;
+    framebuffer_info.pAttachments = &image_view;
+    framebuffer_info.width = extent.width;
+    framebuffer_info.height = extent.height;
+    framebuffer_info.layers = 1;
+    r = from_result (vkCreateFramebuffer (device, &framebuffer_info, nullptr, &image_framebuffer));
+    if (r != vulkan_error_code::success)
+      throw std::system_error (make_error_code (r));
+  }
+
+  void create_buffer (VkPhysicalDevice physical_device)
+  {
+    using fastdraw::output::vulkan::from_result;
+    using fastdraw::output::vulkan::vulkan_error_code;
+
+    VkBufferCreateInfo buffer_info = {VK_STRUCTURE_TYPE_BUFFER_CREATE_INFO};
+    buffer_info.size = VkDeviceSize (extent.width) * extent.height * 4;
+    buffer_info.usage = VK_BUFFER_USAGE_TRANSFER_DST_BIT;
+    buffer_info.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
+    auto r = from_result (vkCreateBuffer (device, &buffer_info, nullptr, &buffer));
+    if (r != vulkan_error_code::success)
+      throw std::system_error (make_error_code (r));
+
+    VkMemoryRequirements requirements;
+    vkGetBufferMemoryRequirements (device, buffer, &requirements);
+    memory = detail::frame_readback_allocate (device, physical_device, requirements
+                                              , VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT
+                                              | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT);
+    r = from_result (vkBindBufferMemory (device, buffer, memory, 0));
+    if (r != vulkan_error_code::success)
+      throw std::system_error (make_error_code (r));
+  }
+
+  // destroying null handles does nothing
+  void destroy ()
+  {
+    vkDestroyFramebuffer (device, image_framebuffer, nullptr);
+    vkDestroyImageView (device, image_view, nullptr);
+    vkDestroyImage (device, image, nullptr);
+    vkFreeMemory (device, image_memory, nullptr);
+    vkDestroyBuffer (device, buffer, nullptr);
+    vkFreeMemory (device, memory, nullptr);
+  }
+
+  VkDevice device;
+  VkExtent2D extent;
+  VkFormat format;
+  VkImage image = VK_NULL_HANDLE;
+  VkDeviceMemory image_memory = VK_NULL_HANDLE;
+  VkImageView image_view = VK_NULL_HANDLE;
+  VkFramebuffer image_framebuffer = VK_NULL_HANDLE;
+  VkBuffer buffer = VK_NULL_HANDLE;
+  VkDeviceMemory memory = VK_NULL_HANDLE;
+};
+
+}
+
+#endif
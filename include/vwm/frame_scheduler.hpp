@@ -0,0 +1,160 @@
+///////////////////////////////////////////////////////////////////////////////
+//
+// Copyright 2019 Felipe Magno de Almeida.
+// Distributed under the Boost Software License, Version 1.0. (See
+// accompanying file LICENSE_1_0.txt or copy at
+// http://www.boost.org/LICENSE_1_0.txt)
+// See http://www.boost.org/libs/foreach for documentation
+//
+
+#ifndef VWM_FRAME_SCHEDULER_HPP
+#define VWM_FRAME_SCHEDULER_HPP
+
+#include <chrono>
+#include <algorithm>
+#include <cstdint>
+
+namespace vwm {
+
+struct frame_scheduler_options
+{
+  // refresh interval assumed until the presentation engine reports one
+  std::chrono::nanoseconds refresh = std::chrono::nanoseconds (16666667);
+  // composition never starts closer than this to the vblank
+  std::chrono::nanoseconds min_margin = std::chrono::microseconds (1000);
+  // added to the measured render time to absorb wakeup and submission
+  // jitter
+  std::chrono::nanoseconds slack = std::chrono::microseconds (1500);
+};
+
+// Decides when the render thread composes the next frame. Composition
+// starts margin() before the predicted vblank, so every commit that
+// arrives until then is drawn in the same frame and what is drawn is
+// as recent as possible. The margin follows the measured render time
+// and the vblank prediction follows the presentation feedback. When
+// there is none, the end of the first frame is taken as a vblank, so
+// the phase and every time predicted from it are only an estimate
+struct frame_scheduler
+{
+  typedef std::chrono::steady_clock clock;
+
+  frame_scheduler (frame_scheduler_options options = {})
+    : options (options), refresh_ (options.refresh)
+  {
+  }
+
+  // when composition of the next frame must start, now when it is
+  // already late for the next vblank it can still target
+  clock::time_point deadline (clock::time_point now) const
+  {
+    return std::max (now, next_vblank (now) - margin());
+  }
+
+  void frame_started (clock::time_point now)
+  {
+    target = next_vblank (now);
+  }
+
+  // the frame composed from started took sample, recording and GPU
+  // execution, until the GPU was done with it. Frames may finish long
+  // after later ones started
+  void frame_finished (clock::time_point started, std::chrono::nanoseconds sample)
+  {
+    // grow at once on a slow frame, shrink slowly when it was a spike
+    if (sample > render_time_)
+      render_time_ = sample;
+    else
+      render_time_ += (sample - render_time_) / 16;
+
+    // an estimate only, replaced by the first presented() time
+    if (vblank == clock::time_point{})
+      vblank = started + sample;
+  }
+
+  // a vblank at which a frame was shown, as reported by the
+  // presentation engine
+  void presented (clock::time_point time)
+  {
+    if (vblank != clock::time_point{} && time > vblank)
+    {
+      auto const interval = std::chrono::duration_cast<std::chrono::nanoseconds> (time - vblank);
+      auto const cycles = (interval.count() + refresh_.count() / 2) / refresh_.count();
+      if (cycles >= 1 && !exact_refresh)
+        refresh_ += (interval / cycles - refresh_) / 8;
+      msc += cycles;
+    }
+    vblank = time;
+  }
+
+  // refresh interval reported by the presentation engine
+  void refresh (std::chrono::nanoseconds interval)
+  {
+    if (interval.count() > 0)
+    {
+      refresh_ = interval;
+      exact_refresh = true;
+    }
+  }
+
+  std::chrono::nanoseconds refresh () const { return refresh_; }
+
+  // how long a frame is expected to take from its start until the GPU
+  // is done with it
+  std::chrono::nanoseconds render_time () const { return render_time_; }
+
+  // vblank the frame started last is expected to be shown at
+  clock::time_point target_vblank () const { return target; }
+
+  std::chrono::nanoseconds margin () const
+  {
+    return std::min (std::max (render_time_ + options.slack, options.min_margin), refresh_);
+  }
+
+  // vertical retrace count at a predicted vblank, counted from the
+  // first frame
+  std::uint64_t sequence (clock::time_point time) const
+  {
+    if (time <= vblank)
+      return msc;
+    auto const interval = std::chrono::duration_cast<std::chrono::nanoseconds> (time - vblank);
+    return msc + (interval.count() + refresh_.count() / 2) / refresh_.count();
+  }
+
+  // first predicted vblank at or after time, a frame the GPU finishes
+  // at time is shown then at the earliest
+  clock::time_point vblank_after (clock::time_point time) const
+  {
+    if (vblank == clock::time_point{} || time <= vblank)
+      return std::max (time, vblank);
+    auto const interval = std::chrono::duration_cast<std::chrono::nanoseconds> (time - vblank).count();
+    return vblank + refresh_ * ((interval + refresh_.count() - 1) / refresh_.count());
+  }
+
+  // first predicted vblank after now that no frame targets yet
+  clock::time_point next_vblank (clock::time_point now) const
+  {
+    if (vblank == clock::time_point{})
+      return now;
+
+    auto const after = std::max (now, target);
+    if (after < vblank)
+      return vblank;
+    auto const cycles = std::chrono::duration_cast<std::chrono::nanoseconds> (after - vblank).count()
+      / refresh_.count() + 1;
+    return vblank + refresh_ * cycles;
+  }
+
+private:
+  frame_scheduler_options options;
+  std::chrono::nanoseconds refresh_;
+  bool exact_refresh = false;
+  std::chrono::nanoseconds render_time_ {0};
+  // last known vblank, the prediction phase
+  clock::time_point vblank;
+  std::uint64_t msc = 0;
+  clock::time_point target;
+};
+
+}
+
+#endif
@@ -0,0 +1,40 @@
+///////////////////////////////////////////////////////////////////////////////
+//
+// Copyright 2019 Felipe Magno de Almeida.
+// Distributed under the Boost Software License, Version 1.0. (See
+// accompanying file LICENSE_1_0.txt or copy at
+// http://www.boost.org/LICENSE_1_0.txt)
+// See http://www.boost.org/libs/foreach for documentation
+//
+
+#ifndef VWM_INDIRECT_SLOT_HPP
+#define VWM_INDIRECT_SLOT_HPP
+
+#include <vwm/region.hpp>
+
+#include <vector>
+#include <algorithm>
+#include <cstddef>
+
+namespace vwm { namespace detail {
+
+// the filler pass only writes the entries of components overlapping
+// its region, so a slot is dirty up to the last of them. Components
+// are binned on the CPU, bounds being in the order of the component
+// buffer
+inline std::size_t render_thread_slot_entries (std::vector<rect> const& bounds, rect area)
+{
+  std::size_t entries = 0;
+  for (std::size_t i = 0; i != bounds.size(); ++i)
+  {
+    auto&& b = bounds[i];
+    if (b.x < area.x + area.width && area.x < b.x + b.width
+        && b.y < area.y + area.height && area.y < b.y + b.height)
+      entries = i + 1;
+  }
+  return std::min<std::size_t> (entries, 4096);
+}
+
+} }
+
+#endif
@@ -0,0 +1,236 @@
+///////////////////////////////////////////////////////////////////////////////
+//
+// Copyright 2019 Felipe Magno de Almeida.
+// Distributed under the Boost Software License, Version 1.0. (See
+// accompanying file LICENSE_1_0.txt or copy at
+// http://www.boost.org/LICENSE_1_0.txt)
+// See http://www.boost.org/libs/foreach for documentation
+//
+
+#ifndef VWM_LOG_HPP
+#define VWM_LOG_HPP
+
+#include <vwm/mpsc_queue.hpp>
+
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <optional>
+#include <sstream>
+#include <string>
+#include <thread>
+#include <cerrno>
+
+#include <poll.h>
+#include <unistd.h>
+#include <sys/eventfd.h>
+
+// messages below this level are not even compiled, 0 is trace and 5
+// disables logging
+#ifndef VWM_LOG_LEVEL
+#ifdef NDEBUG
+#define VWM_LOG_LEVEL 2
+#else
+#define VWM_LOG_LEVEL 1
+#endif
+#endif
+
+namespace vwm { namespace log {
+
+enum class level { trace, debug, info, warning, error, off };
+
+enum class subsystem { main, render, wayland, input, backend, count };
+
+inline char const* level_name (level l)
+{
+  static char const* const names[] = {"trace", "debug", "info", "warning", "error", "off"};
+  return names[static_cast<int>(l)];
+}
+
+inline char const* subsystem_name (subsystem s)
+{
+  static char const* const names[] = {"main", "render", "wayland", "input", "backend"};
+  return names[static_cast<int>(s)];
+}
+
+struct record
+{
+  std::chrono::steady_clock::time_point time;
+  level severity;
+  subsystem from;
+  std::string message;
+};
+
+// Formats on the calling thread and hands the line to a sink thread
+// through a lock-free queue, so logging never takes a lock or flushes
+// a stream on the caller. The eventfd is only written when the sink
+// may be sleeping, a burst of messages costs one wakeup
+struct logger
+{
+  logger ()
+    : fd (::eventfd (0, EFD_CLOEXEC | EFD_NONBLOCK))
+  {
+    for (auto&& l : levels)
+      l.store (level::info, std::memory_order_relaxed);
+    if (char const* spec = std::getenv ("VWM_LOG"))
+      configure (spec);
+    sink = std::thread ([this] { run(); });
+  }
+
+  logger (logger const&) = delete;
+  logger& operator= (logger const&) = delete;
+
+  ~logger ()
+  {
+    exit.store (true);
+    wake ();
+    sink.join();
+    ::close (fd);
+  }
+
+  bool enabled (level l, subsystem s) const
+  {
+    return l >= levels[static_cast<int>(s)].load (std::memory_order_relaxed);
+  }
+
+  void set_level (subsystem s, level l)
+  {
+    levels[static_cast<int>(s)].store (l, std::memory_order_relaxed);
+  }
+
+  // "level" or "subsystem=level" separated by commas, for example
+  // "warning,render=debug"
+  void configure (char const* spec)
+  {
+    std::string const s (spec);
+    std::size_t first = 0;
+    while (first <= s.size())
+    {
+      auto last = s.find (',', first);
+      if (last == std::string::npos)
+        last = s.size();
+      auto const item = s.substr (first, last - first);
+      auto const equal = item.find ('=');
+      if (equal == std::string::npos)
+      {
+        if (auto l = parse_level (item))
+          for (auto&& level : levels)
+            level.store (*l, std::memory_order_relaxed);
+      }
+      else if (auto l = parse_level (item.substr (equal + 1)))
+      {
+        for (int i = 0; i != static_cast<int>(subsystem::count); ++i)
+          if (item.compare (0, equal, subsystem_name (static_cast<subsystem>(i))) == 0)
+            set_level (static_cast<subsystem>(i), *l);
+      }
+      first = last + 1;
+    }
+  }
+
+  void write (record r)
+  {
+    records.push (std::move (r));
+    if (!signaled.exchange (true))
+      wake ();
+  }
+
+private:
+  static std::optional<level> parse_level (std::string const& name)
+  {
+    for (int i = 0; i <= static_cast<int>(level::off); ++i)
+      if (name == level_name (static_cast<level>(i)))
+        return static_cast<level>(i);
+    return std::nullopt;
+  }
+
+  void wake ()
+  {
+    std::uint64_t const one = 1;
+    while (::write (fd, &one, sizeof one) < 0 && errno == EINTR)
+      ;
+  }
+
+  void run ()
+  {
+    auto const start = std::chrono::steady_clock::now();
+    while (true)
+    {
+      ::pollfd pfd = {fd, POLLIN, 0};
+      if (::poll (&pfd, 1, -1) < 0 && errno != EINTR)
+        break;
+      std::uint64_t value;
+      while (::read (fd, &value, sizeof value) < 0 && errno == EINTR)
+        ;
+      // a producer seeing true after this has its record drained below
+      signaled.store (false);
+      bool const exiting = exit.load();
+      // a push still linking its record hides it and the records after
+      // it from pop, while its producer may have skipped the wakeup
+      // because signaled was still set, so it is waited for here
+      do
+      {
+        while (auto r = records.pop())
+        {
+          auto const us = std::chrono::duration_cast<std::chrono::microseconds>(r->time - start).count();
+          std::fprintf (stdout, "%lld.%06lld %s %s: %s\n", static_cast<long long>(us / 1000000)
+                        , static_cast<long long>(us % 1000000), level_name (r->severity)
+                        , subsystem_name (r->from), r->message.c_str());
+        }
+        if (!records.empty())
+          std::this_thread::yield();
+      }
+      while (!records.empty());
+      std::fflush (stdout);
+      if (exiting)
+        break;
+    }
+  }
+
+  int fd;
+  std::atomic<level> levels[static_cast<int>(subsystem::count)];
+  mpsc_queue<record> records;
+  std::atomic<bool> signaled {false}, exit {false};
+  std::thread sink;
+};
+
+inline logger& instance ()
+{
+  static logger l;
+  return l;
+}
+
+// the stream messages are formatted in, one per thread and reused so a
+// message does not construct a stream and its locale. A message must
+// not log while it is formatted
+inline std::ostringstream& thread_stream ()
+{
+  thread_local std::ostringstream stream;
+  stream.str (std::string());
+  stream.clear();
+  stream.flags (std::ios_base::skipws | std::ios_base::dec);
+  stream.precision (6);
+  stream.fill (' ');
+  return stream;
+}
+
+} }
+
+// VWM_LOG (debug, render, "recording " << count << " regions");
+#define VWM_LOG(level_, subsystem_, ...)                                 \
+  do                                                                    \
+  {                                                                     \
+    if constexpr (static_cast<int>(::vwm::log::level::level_) >= VWM_LOG_LEVEL) \
+    {                                                                   \
+      auto& vwm_logger_ = ::vwm::log::instance();                       \
+      if (vwm_logger_.enabled (::vwm::log::level::level_, ::vwm::log::subsystem::subsystem_)) \
+      {                                                                 \
+        auto& vwm_log_stream_ = ::vwm::log::thread_stream();            \
+        vwm_log_stream_ << __VA_ARGS__;                                 \
+        vwm_logger_.write ({std::chrono::steady_clock::now(), ::vwm::log::level::level_ \
+                            , ::vwm::log::subsystem::subsystem_, vwm_log_stream_.str()}); \
+      }                                                                 \
+    }                                                                   \
+  } while (0)
+
+#endif
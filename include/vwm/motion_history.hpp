@@ -0,0 +1,72 @@
+///////////////////////////////////////////////////////////////////////////////
+//
+// Copyright 2019 Felipe Magno de Almeida.
+// Distributed under the Boost Software License, Version 1.0. (See
+// accompanying file LICENSE_1_0.txt or copy at
+// http://www.boost.org/LICENSE_1_0.txt)
+// See http://www.boost.org/libs/foreach for documentation
+//
+
+#ifndef VWM_MOTION_HISTORY_HPP
+#define VWM_MOTION_HISTORY_HPP
+
+#include <vector>
+#include <cstdint>
+
+namespace vwm {
+
+struct motion_sample
+{
+  // milliseconds, as in the input event
+  std::uint32_t time;
+  std::int32_t dx, dy;
+};
+
+// Pointer deltas that were coalesced away, for consumers that need
+// every motion and not only the latest position. Keeps the last
+// capacity samples, a capacity of 0 records nothing
+struct motion_history
+{
+  motion_history (std::size_t capacity = 0)
+    : samples (capacity) {}
+
+  bool enabled () const { return !samples.empty(); }
+
+  void record (std::uint32_t time, std::int32_t x, std::int32_t y)
+  {
+    if (samples.empty())
+      return;
+    if (has_last)
+    {
+      samples[(first + count) % samples.size()] = {time, x - last_x, y - last_y};
+      if (count == samples.size())
+        first = (first + 1) % samples.size();
+      else
+        ++count;
+    }
+    has_last = true;
+    last_x = x;
+    last_y = y;
+  }
+
+  // oldest first, empties the history
+  template <typename F>
+  void consume (F f)
+  {
+    for (std::size_t i = 0; i != count; ++i)
+      f (samples[(first + i) % samples.size()]);
+    first = count = 0;
+  }
+
+  std::size_t size () const { return count; }
+
+private:
+  std::vector<motion_sample> samples;
+  std::size_t first = 0, count = 0;
+  bool has_last = false;
+  std::int32_t last_x = 0, last_y = 0;
+};
+
+}
+
+#endif
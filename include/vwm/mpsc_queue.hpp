@@ -0,0 +1,89 @@
+///////////////////////////////////////////////////////////////////////////////
+//
+// Copyright 2019 Felipe Magno de Almeida.
+// Distributed under the Boost Software License, Version 1.0. (See
+// accompanying file LICENSE_1_0.txt or copy at
+// http://www.boost.org/LICENSE_1_0.txt)
+// See http://www.boost.org/libs/foreach for documentation
+//
+
+#ifndef VWM_MPSC_QUEUE_HPP
+#define VWM_MPSC_QUEUE_HPP
+
+#include <atomic>
+#include <optional>
+#include <utility>
+
+namespace vwm {
+
+// Unbounded lock-free queue for many producers and one consumer, after
+// Dmitry Vyukov's node based MPSC queue. push is wait-free, a value
+// whose push is still in progress is not seen by pop until the push
+// links it, so producers must wake the consumer after pushing.
+// Operations are sequentially consistent, so a push followed by other
+// atomic operations is ordered with them
+template <typename T>
+struct mpsc_queue
+{
+  mpsc_queue () : head (&stub), tail (&stub) {}
+  mpsc_queue (mpsc_queue const&) = delete;
+  mpsc_queue& operator= (mpsc_queue const&) = delete;
+
+  ~mpsc_queue ()
+  {
+    while (pop())
+      ;
+    if (tail != &stub)
+      delete tail;
+  }
+
+  // any thread
+  void push (T value)
+  {
+    node* n = new node (std::move (value));
+    node* previous = head.exchange (n);
+    previous->next.store (n);
+  }
+
+  // consumer thread only
+  std::optional<T> pop ()
+  {
+    node* first = tail;
+    node* next = first->next.load();
+    if (!next)
+      return std::nullopt;
+
+    // next becomes the new dummy node
+    std::optional<T> value (std::move (next->value));
+    next->value.reset();
+    tail = next;
+    if (first != &stub)
+      delete first;
+    return value;
+  }
+
+  // consumer thread only, false as soon as a push started, even while
+  // pop cannot take its value yet
+  bool empty () const
+  {
+    return !tail->next.load() && head.load() == tail;
+  }
+
+private:
+  struct node
+  {
+    node () = default;
+    node (T value) : value (std::move (value)) {}
+
+    std::atomic<node*> next {nullptr};
+    std::optional<T> value;
+  };
+
+  std::atomic<node*> head;
+  node* tail;
+  node stub;
+};
+
+}
+
+#endif
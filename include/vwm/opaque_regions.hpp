@@ -0,0 +1,49 @@
+///////////////////////////////////////////////////////////////////////////////
+//
+// Copyright 2019 Felipe Magno de Almeida.
+// Distributed under the Boost Software License, Version 1.0. (See
+// accompanying file LICENSE_1_0.txt or copy at
+// http://www.boost.org/LICENSE_1_0.txt)
+// See http://www.boost.org/libs/foreach for documentation
+//
+
+#ifndef VWM_OPAQUE_REGIONS_HPP
+#define VWM_OPAQUE_REGIONS_HPP
+
+#include <vwm/region.hpp>
+
+#include <unordered_map>
+
+namespace vwm {
+
+// Opaque part of each toplevel component, in component coordinates,
+// keyed by the component address. Written by the clients on commit and
+// read when the loop thread builds a scene
+struct opaque_regions
+{
+  void set (void const* component, region opaque)
+  {
+    if (opaque.empty())
+      regions.erase (component);
+    else
+      regions[component] = std::move (opaque);
+  }
+
+  void erase (void const* component)
+  {
+    regions.erase (component);
+  }
+
+  region const* find (void const* component) const
+  {
+    auto it = regions.find (component);
+    return it == regions.end() ? nullptr : &it->second;
+  }
+
+private:
+  std::unordered_map<void const*, region> regions;
+};
+
+}
+
+#endif
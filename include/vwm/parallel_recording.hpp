@@ -0,0 +1,101 @@
+///////////////////////////////////////////////////////////////////////////////
+//
+// Copyright 2019 Felipe Magno de Almeida.
+// Distributed under the Boost Software License, Version 1.0. (See
+// accompanying file LICENSE_1_0.txt or copy at
+// http://www.boost.org/LICENSE_1_0.txt)
+// See http://www.boost.org/libs/foreach for documentation
+//
+
+#ifndef VWM_PARALLEL_RECORDING_HPP
+#define VWM_PARALLEL_RECORDING_HPP
+
+#include <condition_variable>
+#include <exception>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <vector>
+#include <cstddef>
+
+namespace vwm { namespace detail {
+
+// runs record (worker) for workers 1 to workers - 1 through post and
+// for worker 0 on the calling thread, returning once all are done.
+// Workers whose task has not started by the time worker 0 is done are
+// recorded on the calling thread too, so a busy executor never delays
+// the frame by more than recording it inline. The first exception
+// thrown by any of them is rethrown
+inline void render_thread_record_parallel (std::function<void(std::function<void()>)> const& post
+                                    , std::size_t workers, std::function<void(std::size_t)> const& record)
+{
+  // outlives this call for tasks that start after their worker was
+  // taken back
+  struct state
+  {
+    std::mutex mutex;
+    std::condition_variable done;
+    std::vector<bool> claimed;
+    std::size_t remaining;
+    std::vector<std::exception_ptr> errors;
+  };
+  auto const shared = std::make_shared<state>();
+  shared->claimed.resize (workers);
+  shared->remaining = workers - 1;
+  shared->errors.resize (workers);
+
+  auto const claim = [] (state& s, std::size_t worker)
+                     {
+                       std::unique_lock<std::mutex> l (s.mutex);
+                       if (s.claimed[worker])
+                         return false;
+                       s.claimed[worker] = true;
+                       return true;
+                     };
+  // only called by whoever claimed the worker, while record is alive
+  auto const run = [&record] (state& s, std::size_t worker)
+                   {
+                     try
+                     {
+                       record (worker);
+                     }
+                     catch (...)
+                     {
+                       s.errors[worker] = std::current_exception();
+                     }
+                   };
+  auto const finish = [] (state& s)
+                      {
+                        std::unique_lock<std::mutex> l (s.mutex);
+                        if (--s.remaining == 0)
+                          s.done.notify_one();
+                      };
+
+  for (std::size_t worker = 1; worker < workers; ++worker)
+    post ([shared, worker, claim, run, finish]
+          {
+            if (!claim (*shared, worker))
+              return;
+            run (*shared, worker);
+            finish (*shared);
+          });
+  run (*shared, 0);
+  for (std::size_t worker = 1; worker < workers; ++worker)
+    if (claim (*shared, worker))
+    {
+      run (*shared, worker);
+      finish (*shared);
+    }
+  {
+    // the workers still recording use the caller's buffers
+    std::unique_lock<std::mutex> l (shared->mutex);
+    shared->done.wait (l, [&] { return shared->remaining == 0; });
+  }
+  for (auto&& error : shared->errors)
+    if (error)
+      std::rethrow_exception (error);
+}
+
+} }
+
+#endif
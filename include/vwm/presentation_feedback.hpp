@@ -0,0 +1,111 @@
+///////////////////////////////////////////////////////////////////////////////
+//
+// Copyright 2019 Felipe Magno de Almeida.
+// Distributed under the Boost Software License, Version 1.0. (See
+// accompanying file LICENSE_1_0.txt or copy at
+// http://www.boost.org/LICENSE_1_0.txt)
+// See http://www.boost.org/libs/foreach for documentation
+//
+
+#ifndef VWM_PRESENTATION_FEEDBACK_HPP
+#define VWM_PRESENTATION_FEEDBACK_HPP
+
+#include <uv.h>
+
+#include <chrono>
+#include <functional>
+#include <list>
+#include <mutex>
+#include <vector>
+#include <cstdint>
+
+namespace vwm {
+
+struct presented_frame
+{
+  // frames are numbered from 1 in the order the render thread composes
+  // them, 0 is no frame
+  std::uint64_t sequence;
+  // the last scene the frame drew, what was pushed up to it is shown
+  std::uint64_t scene;
+  // vblank the frame was shown at, in CLOCK_MONOTONIC
+  std::chrono::steady_clock::time_point time;
+  std::chrono::nanoseconds refresh;
+  // vertical retrace counter at time
+  std::uint64_t msc;
+  // time was given by the presentation engine, otherwise it is the
+  // vblank predicted when the frame's fence signaled
+  bool exact = false;
+};
+
+// Tells the uv loop which frames reached the screen. The render thread
+// reports each frame with the last scene it drew once the GPU is done
+// with it, listeners run in the loop thread with every frame presented
+// since the loop last woke up, in order
+struct presentation_feedback
+{
+  typedef std::function<void(presented_frame const&)> listener_type;
+  typedef std::list<listener_type>::iterator connection;
+
+  presentation_feedback (uv_loop_t* loop)
+  {
+    ::uv_async_init (loop, &async, [] (uv_async_t* handle)
+                                   {
+                                     static_cast<presentation_feedback*>(handle->data)->dispatch();
+                                   });
+    async.data = this;
+    // listeners alone do not keep the loop running
+    ::uv_unref (reinterpret_cast<uv_handle_t*>(&async));
+  }
+
+  presentation_feedback (presentation_feedback const&) = delete;
+  presentation_feedback& operator= (presentation_feedback const&) = delete;
+
+  void close ()
+  {
+    ::uv_close (reinterpret_cast<uv_handle_t*>(&async), nullptr);
+  }
+
+  // loop thread
+  connection connect (listener_type listener)
+  {
+    return listeners.insert (listeners.end(), std::move (listener));
+  }
+  void disconnect (connection c)
+  {
+    listeners.erase (c);
+  }
+
+  // render thread
+  void frame_presented (presented_frame frame)
+  {
+    {
+      std::unique_lock<std::mutex> l (mutex);
+      presented.push_back (frame);
+    }
+    ::uv_async_send (&async);
+  }
+
+private:
+  void dispatch ()
+  {
+    std::vector<presented_frame> frames;
+    {
+      std::unique_lock<std::mutex> l (mutex);
+      frames.swap (presented);
+    }
+    for (auto&& frame : frames)
+      for (auto it = listeners.begin(); it != listeners.end();)
+        // a listener may disconnect itself
+        (*it++) (frame);
+  }
+
+  uv_async_t async;
+  std::list<listener_type> listeners;
+  std::mutex mutex;
+  std::vector<presented_frame> presented;
+};
+
+}
+
+#endif
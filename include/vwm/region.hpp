@@ -0,0 +1,259 @@
+///////////////////////////////////////////////////////////////////////////////
+//
+// Copyright 2019 Felipe Magno de Almeida.
+// Distributed under the Boost Software License, Version 1.0. (See
+// accompanying file LICENSE_1_0.txt or copy at
+// http://www.boost.org/LICENSE_1_0.txt)
+// See http://www.boost.org/libs/foreach for documentation
+//
+
+#ifndef VWM_REGION_HPP
+#define VWM_REGION_HPP
+
+#include <vector>
+#include <algorithm>
+#include <cstdint>
+
+namespace vwm {
+
+struct rect
+{
+  std::int32_t x, y, width, height;
+};
+
+// set of pixels stored as horizontal bands, each band holding the
+// sorted and disjoint x spans covered between its y1 and y2. Bands are
+// sorted, never overlap and adjacent bands with the same spans are
+// merged, so every region has a single representation
+struct region
+{
+  struct span
+  {
+    std::int32_t x1, x2;
+
+    friend bool operator== (span const& lhs, span const& rhs)
+    {
+      return lhs.x1 == rhs.x1 && lhs.x2 == rhs.x2;
+    }
+  };
+
+  struct band
+  {
+    std::int32_t y1, y2;
+    std::vector<span> spans;
+
+    friend bool operator== (band const& lhs, band const& rhs)
+    {
+      return lhs.y1 == rhs.y1 && lhs.y2 == rhs.y2 && lhs.spans == rhs.spans;
+    }
+  };
+
+  // every region has a single representation, so equal regions have
+  // equal bands
+  friend bool operator== (region const& lhs, region const& rhs)
+  {
+    return lhs.bands == rhs.bands;
+  }
+  friend bool operator!= (region const& lhs, region const& rhs)
+  {
+    return !(lhs == rhs);
+  }
+
+  region () = default;
+  region (rect r)
+  {
+    if (r.width > 0 && r.height > 0)
+      bands.push_back ({r.y, r.y + r.height, {{r.x, r.x + r.width}}});
+  }
+
+  bool empty () const { return bands.empty(); }
+  void clear () { bands.clear(); }
+
+  rect extents () const
+  {
+    if (bands.empty())
+      return {0, 0, 0, 0};
+
+    std::int32_t x1 = bands.front().spans.front().x1, x2 = bands.front().spans.back().x2;
+    for (auto&& band : bands)
+    {
+      x1 = std::min (x1, band.spans.front().x1);
+      x2 = std::max (x2, band.spans.back().x2);
+    }
+    return {x1, bands.front().y1, x2 - x1, bands.back().y2 - bands.front().y1};
+  }
+
+  std::size_t rect_count () const
+  {
+    std::size_t count = 0;
+    for (auto&& band : bands)
+      count += band.spans.size();
+    return count;
+  }
+
+  std::int64_t area () const
+  {
+    std::int64_t area = 0;
+    for (auto&& band : bands)
+      for (auto&& span : band.spans)
+        area += static_cast<std::int64_t>(span.x2 - span.x1) * (band.y2 - band.y1);
+    return area;
+  }
+
+  std::vector<rect> rects () const
+  {
+    std::vector<rect> rects;
+    rects.reserve (rect_count());
+    for (auto&& band : bands)
+      for (auto&& span : band.spans)
+        rects.push_back ({span.x1, band.y1, span.x2 - span.x1, band.y2 - band.y1});
+    return rects;
+  }
+
+  // true when every pixel of r is in the region
+  bool contains (rect r) const
+  {
+    if (r.width <= 0 || r.height <= 0)
+      return true;
+    region remaining (r);
+    remaining.subtract (*this);
+    return remaining.empty();
+  }
+
+  bool intersects (rect r) const
+  {
+    region common (r);
+    common.intersect (*this);
+    return !common.empty();
+  }
+
+  void translate (std::int32_t dx, std::int32_t dy)
+  {
+    for (auto&& band : bands)
+    {
+      band.y1 += dy;
+      band.y2 += dy;
+      for (auto&& span : band.spans)
+      {
+        span.x1 += dx;
+        span.x2 += dx;
+      }
+    }
+  }
+
+  region& unite (region const& other)
+  {
+    if (other.empty())
+      return *this;
+    if (empty())
+      return *this = other;
+    return *this = combine (*this, other, [] (bool a, bool b) { return a || b; });
+  }
+  region& intersect (region const& other)
+  {
+    return *this = combine (*this, other, [] (bool a, bool b) { return a && b; });
+  }
+  region& subtract (region const& other)
+  {
+    if (empty() || other.empty())
+      return *this;
+    return *this = combine (*this, other, [] (bool a, bool b) { return a && !b; });
+  }
+
+  region& unite (rect r) { return unite (region (r)); }
+  region& intersect (rect r) { return intersect (region (r)); }
+  region& subtract (rect r) { return subtract (region (r)); }
+
+  std::vector<band> bands;
+private:
+  static std::vector<span> const* spans_at (std::vector<band> const& bands
+                                            , typename std::vector<band>::const_iterator& it
+                                            , std::int32_t y)
+  {
+    static const std::vector<span> none;
+    while (it != bands.end() && it->y2 <= y)
+      ++it;
+    return it != bands.end() && it->y1 <= y ? &it->spans : &none;
+  }
+
+  template <typename Op>
+  static void combine_spans (std::vector<span> const& a, std::vector<span> const& b
+                             , std::vector<span>& result, Op op)
+  {
+    std::vector<std::int32_t> xs;
+    xs.reserve ((a.size() + b.size()) * 2);
+    for (auto&& s : a) { xs.push_back (s.x1); xs.push_back (s.x2); }
+    for (auto&& s : b) { xs.push_back (s.x1); xs.push_back (s.x2); }
+    std::sort (xs.begin(), xs.end());
+    xs.erase (std::unique (xs.begin(), xs.end()), xs.end());
+
+    auto ia = a.begin(), ib = b.begin();
+    for (std::size_t i = 0; i + 1 < xs.size(); ++i)
+    {
+      auto x = xs[i];
+      while (ia != a.end() && ia->x2 <= x) ++ia;
+      while (ib != b.end() && ib->x2 <= x) ++ib;
+      bool in_a = ia != a.end() && ia->x1 <= x;
+      bool in_b = ib != b.end() && ib->x1 <= x;
+      if (op (in_a, in_b))
+      {
+        if (!result.empty() && result.back().x2 == x)
+          result.back().x2 = xs[i + 1];
+        else
+          result.push_back ({x, xs[i + 1]});
+      }
+    }
+  }
+
+  template <typename Op>
+  static region combine (region const& a, region const& b, Op op)
+  {
+    std::vector<std::int32_t> ys;
+    ys.reserve ((a.bands.size() + b.bands.size()) * 2);
+    for (auto&& band : a.bands) { ys.push_back (band.y1); ys.push_back (band.y2); }
+    for (auto&& band : b.bands) { ys.push_back (band.y1); ys.push_back (band.y2); }
+    std::sort (ys.begin(), ys.end());
+    ys.erase (std::unique (ys.begin(), ys.end()), ys.end());
+
+    region result;
+    auto ia = a.bands.begin(), ib = b.bands.begin();
+    std::vector<span> spans;
+    for (std::size_t i = 0; i + 1 < ys.size(); ++i)
+    {
+      auto y1 = ys[i], y2 = ys[i + 1];
+      spans.clear();
+      combine_spans (*spans_at (a.bands, ia, y1), *spans_at (b.bands, ib, y1), spans, op);
+      if (spans.empty())
+        continue;
+
+      if (!result.bands.empty() && result.bands.back().y2 == y1
+          && result.bands.back().spans == spans)
+        result.bands.back().y2 = y2;
+      else
+        result.bands.push_back ({y1, y2, spans});
+    }
+    return result;
+  }
+};
+
+// Replaces a fragmented region by its bounding box once describing it
+// rect by rect costs more than drawing the extra pixels, or when it has
+// more rects than max_rects. rect_cost is the overhead of one rect
+// expressed in pixels
+inline region simplify (region const& r, std::size_t max_rects, std::int64_t rect_cost)
+{
+  auto const count = r.rect_count();
+  if (count <= 1)
+    return r;
+
+  auto const extents = r.extents();
+  auto const extents_area = static_cast<std::int64_t>(extents.width) * extents.height;
+  if (count > max_rects
+      || extents_area <= r.area() + static_cast<std::int64_t>(count - 1) * rect_cost)
+    return region (extents);
+  return r;
+}
+
+}
+
+#endif
@@ -0,0 +1,132 @@
+///////////////////////////////////////////////////////////////////////////////
+//
+// Copyright 2019 Felipe Magno de Almeida.
+// Distributed under the Boost Software License, Version 1.0. (See
+// accompanying file LICENSE_1_0.txt or copy at
+// http://www.boost.org/LICENSE_1_0.txt)
+// See http://www.boost.org/libs/foreach for documentation
+//
+
+#ifndef VWM_RENDER_METRICS_HPP
+#define VWM_RENDER_METRICS_HPP
+
+#include <algorithm>
+#include <chrono>
+#include <mutex>
+#include <ostream>
+#include <vector>
+#include <cstdint>
+
+namespace vwm {
+
+// GPU execution time of one frame, from its timestamp queries
+struct frame_timings
+{
+  // position of the frame among the frames composed, from 1
+  std::uint64_t frame;
+  // indirect filler passes and image passes of all regions
+  std::chrono::nanoseconds filler, image;
+  // first to last timestamp of the frame
+  std::chrono::nanoseconds total;
+  // filler and image pass of each region, a single entry covering all
+  // regions when they are recorded in a single pass
+  std::vector<std::chrono::nanoseconds> regions;
+  // CPU time the render thread waited for the graphics queue, shared
+  // with the uploads, before submitting the frame
+  std::chrono::nanoseconds queue_wait {0};
+};
+
+struct stage_statistics
+{
+  std::chrono::nanoseconds min {0}, avg {0}, p99 {0};
+  std::size_t samples = 0;
+};
+
+struct render_statistics
+{
+  stage_statistics filler, image, region, total, queue_wait;
+  std::uint64_t last_frame = 0;
+};
+
+inline std::ostream& operator<< (std::ostream& os, stage_statistics const& s)
+{
+  using std::chrono::microseconds;
+  using std::chrono::duration_cast;
+  return os << "min " << duration_cast<microseconds>(s.min).count()
+            << "us avg " << duration_cast<microseconds>(s.avg).count()
+            << "us p99 " << duration_cast<microseconds>(s.p99).count()
+            << "us (" << s.samples << " samples)";
+}
+
+// Timings of the last frames the render thread collected. The render
+// thread records a frame when its fence signaled, so timings arrive
+// at least one frame late, statistics may be read from any thread
+struct render_metrics
+{
+  render_metrics (std::size_t window = 600)
+    : window (std::max<std::size_t>(1, window)) {}
+
+  // render thread
+  void record (frame_timings timings)
+  {
+    std::unique_lock<std::mutex> l (mutex);
+    if (frames.size() == window)
+    {
+      frames[next] = std::move (timings);
+      next = (next + 1) % window;
+    }
+    else
+      frames.push_back (std::move (timings));
+  }
+
+  render_statistics statistics () const
+  {
+    std::vector<std::chrono::nanoseconds> filler, image, region, total, queue_wait;
+    render_statistics s;
+    {
+      std::unique_lock<std::mutex> l (mutex);
+      for (auto&& frame : frames)
+      {
+        filler.push_back (frame.filler);
+        image.push_back (frame.image);
+        total.push_back (frame.total);
+        queue_wait.push_back (frame.queue_wait);
+        region.insert (region.end(), frame.regions.begin(), frame.regions.end());
+        s.last_frame = std::max (s.last_frame, frame.frame);
+      }
+    }
+    s.filler = summarize (filler);
+    s.image = summarize (image);
+    s.region = summarize (region);
+    s.total = summarize (total);
+    s.queue_wait = summarize (queue_wait);
+    return s;
+  }
+
+private:
+  static stage_statistics summarize (std::vector<std::chrono::nanoseconds>& samples)
+  {
+    stage_statistics s;
+    if (samples.empty())
+      return s;
+    std::sort (samples.begin(), samples.end());
+    std::chrono::nanoseconds sum {0};
+    for (auto&& sample : samples)
+      sum += sample;
+    s.min = samples.front();
+    s.avg = sum / samples.size();
+    s.p99 = samples[(samples.size() * 99 + 99) / 100 - 1];
+    s.samples = samples.size();
+    return s;
+  }
+
+  std::size_t window;
+  std::vector<frame_timings> frames;
+  // oldest frame once the window is full
+  std::size_t next = 0;
+  mutable std::mutex mutex;
+};
+
+}
+
+#endif
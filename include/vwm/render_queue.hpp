@@ -0,0 +1,112 @@
+///////////////////////////////////////////////////////////////////////////////
+//
+// Copyright 2019 Felipe Magno de Almeida.
+// Distributed under the Boost Software License, Version 1.0. (See
+// accompanying file LICENSE_1_0.txt or copy at
+// http://www.boost.org/LICENSE_1_0.txt)
+// See http://www.boost.org/libs/foreach for documentation
+//
+
+#ifndef VWM_RENDER_QUEUE_HPP
+#define VWM_RENDER_QUEUE_HPP
+
+#include <vwm/scene.hpp>
+#include <vwm/mpsc_queue.hpp>
+
+#include <chrono>
+#include <memory>
+#include <optional>
+#include <system_error>
+#include <variant>
+#include <algorithm>
+#include <cstdint>
+#include <cerrno>
+
+#include <poll.h>
+#include <unistd.h>
+#include <sys/eventfd.h>
+
+namespace vwm {
+
+struct render_exit_request {};
+
+// Operations for the render thread, in the order they were pushed from
+// any thread. The render thread drains them once per frame and sleeps
+// on an eventfd between frames. Scenes are numbered as they are pushed,
+// so they must all be pushed from the same thread, the loop thread
+struct render_queue
+{
+  typedef std::variant<std::unique_ptr<scene>, render_exit_request> operation;
+  typedef std::chrono::steady_clock clock;
+
+  render_queue ()
+    : fd (::eventfd (0, EFD_CLOEXEC | EFD_NONBLOCK))
+  {
+    if (fd < 0)
+      throw std::system_error (errno, std::system_category());
+  }
+  render_queue (render_queue const&) = delete;
+  render_queue& operator= (render_queue const&) = delete;
+
+  ~render_queue ()
+  {
+    ::close (fd);
+  }
+
+  // returns the number of the scene pushed, 0 for other operations
+  std::uint64_t push (operation op)
+  {
+    std::uint64_t sequence = 0;
+    if (auto* s = std::get_if<std::unique_ptr<scene>>(&op))
+      sequence = (*s)->sequence = ++scenes;
+    operations.push (std::move (op));
+    std::uint64_t const one = 1;
+    while (::write (fd, &one, sizeof one) < 0 && errno == EINTR)
+      ;
+    return sequence;
+  }
+
+  // render thread
+  std::optional<operation> pop ()
+  {
+    return operations.pop();
+  }
+
+  // render thread, returns false when deadline passed without a push
+  bool wait (std::optional<clock::time_point> deadline = std::nullopt)
+  {
+    ::pollfd pfd = {fd, POLLIN, 0};
+    ::timespec timeout, *timeout_ptr = nullptr;
+    if (deadline)
+    {
+      auto const left = std::max (clock::duration::zero(), *deadline - clock::now());
+      auto const seconds = std::chrono::duration_cast<std::chrono::seconds> (left);
+      timeout.tv_sec = seconds.count();
+      timeout.tv_nsec = std::chrono::duration_cast<std::chrono::nanoseconds> (left - seconds).count();
+      timeout_ptr = &timeout;
+    }
+
+    auto r = ::ppoll (&pfd, 1, timeout_ptr, nullptr);
+    if (r < 0)
+    {
+      if (errno == EINTR)
+        return true;
+      throw std::system_error (errno, std::system_category());
+    }
+    if (r == 0)
+      return false;
+
+    std::uint64_t count;
+    ::read (fd, &count, sizeof count);
+    return true;
+  }
+
+private:
+  mpsc_queue<operation> operations;
+  std::uint64_t scenes = 0;
+  int fd;
+};
+
+}
+
+#endif
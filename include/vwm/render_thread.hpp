@@ -13,9 +13,32 @@
 #include <ftk/ui/toplevel_window.hpp>
 #include <ftk/ui/backend/vulkan_indirect_draw.hpp>
 
+#include <vwm/region.hpp>
+#include <vwm/damage_history.hpp>
+#include <vwm/frame_scheduler.hpp>
+#include <vwm/presentation_feedback.hpp>
+#include <vwm/scene.hpp>
+#include <vwm/scene_gate.hpp>
+#include <vwm/render_queue.hpp>
+#include <vwm/frame_readback.hpp>
+#include <vwm/indirect_slot.hpp>
+#include <vwm/parallel_recording.hpp>
+#include <vwm/render_metrics.hpp>
+#include <vwm/log.hpp>
+
 #include <thread>
-#include <mutex>
 #include <condition_variable>
+#include <deque>
+#include <exception>
+#include <filesystem>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <optional>
+#include <variant>
+#include <vector>
+#include <algorithm>
+#include <cstring>
 
 namespace vwm {
 
@@ -49,7 +72,7 @@ VkSampler render_thread_create_sampler (VkDevice device)
   samplerInfo.minLod = 0.0f;
   samplerInfo.maxLod = 0.0f;
        
-  std::cout << __FILE__ ":" << __LINE__ << std::endl;
+  VWM_LOG (trace, render, __FILE__ ":" << __LINE__);
   VkSampler texture_sampler;
   //CHRONO_COMPARE()
   auto r = from_result(vkCreateSampler(device, &samplerInfo, nullptr, &texture_sampler));
@@ -72,14 +95,549 @@ VkSemaphore render_thread_create_semaphore (VkDevice device)
     throw std::system_error(make_error_code(r));
   return semaphore;
 }
+
+VkFence render_thread_create_fence (VkDevice device)
+{
+  using fastdraw::output::vulkan::from_result;
+  using fastdraw::output::vulkan::vulkan_error_code;
+  VkFence fence;
+  VkFenceCreateInfo fenceInfo = {};
+  fenceInfo.sType = VK_STRUCTURE_TYPE_FENCE_CREATE_INFO;
+
+  auto r = from_result (vkCreateFence (device, &fenceInfo, nullptr, &fence));
+  if (r != vulkan_error_code::success)
+    throw std::system_error(make_error_code(r));
+  return fence;
+}
+
+uint32_t render_thread_swapchain_image_count (VkDevice device, VkSwapchainKHR swapchain)
+{
+  using fastdraw::output::vulkan::from_result;
+  using fastdraw::output::vulkan::vulkan_error_code;
+  uint32_t image_count = 0;
+  auto r = from_result (vkGetSwapchainImagesKHR (device, swapchain, &image_count, nullptr));
+  if (r != vulkan_error_code::success)
+    throw std::system_error(make_error_code(r));
+  return image_count;
+}
+
+bool render_thread_has_device_extension (VkPhysicalDevice physical_device, const char* name)
+{
+  uint32_t extension_count = 0;
+  vkEnumerateDeviceExtensionProperties (physical_device, nullptr, &extension_count, nullptr);
+  std::vector<VkExtensionProperties> extensions (extension_count);
+  vkEnumerateDeviceExtensionProperties (physical_device, nullptr, &extension_count, extensions.data());
+
+  for (auto&& extension : extensions)
+    if (!std::strcmp (extension.extensionName, name))
+      return true;
+  return false;
+}
+
+// the graphics queue is taken from the first family with graphics
+// support, the same one the backend creates its device with
+uint32_t render_thread_graphics_queue_family (VkPhysicalDevice physical_device)
+{
+  uint32_t family_count = 0;
+  vkGetPhysicalDeviceQueueFamilyProperties (physical_device, &family_count, nullptr);
+  std::vector<VkQueueFamilyProperties> families (family_count);
+  vkGetPhysicalDeviceQueueFamilyProperties (physical_device, &family_count, families.data());
+
+  for (uint32_t i = 0; i != family_count; ++i)
+    if (families[i].queueFlags & VK_QUEUE_GRAPHICS_BIT)
+      return i;
+  throw std::runtime_error ("no graphics queue family");
+}
+
+VkCommandPool render_thread_create_command_pool (VkDevice device, uint32_t queue_family)
+{
+  using fastdraw::output::vulkan::from_result;
+  using fastdraw::output::vulkan::vulkan_error_code;
+  VkCommandPool command_pool;
+  VkCommandPoolCreateInfo poolInfo = {};
+  poolInfo.sType = VK_STRUCTURE_TYPE_COMMAND_POOL_CREATE_INFO;
+  poolInfo.flags = VK_COMMAND_POOL_CREATE_TRANSIENT_BIT;
+  poolInfo.queueFamilyIndex = queue_family;
+
+  auto r = from_result (vkCreateCommandPool (device, &poolInfo, nullptr, &command_pool));
+  if (r != vulkan_error_code::success)
+    throw std::system_error(make_error_code(r));
+  return command_pool;
+}
+
+// synchronization objects for one frame, created once and recycled
+// every time the frame that used them retires
+struct render_frame_context
+{
+  VkSemaphore image_available;
+  VkSemaphore render_finished;
+  VkFence execution_finished;
+  bool in_flight;
+  // owned by this frame only, reset as a whole when the frame retires,
+  // command buffers are kept allocated and reused by the next frames
+  VkCommandPool command_pool;
+  std::vector<VkCommandBuffer> command_buffers;
+  // timestamps written by the frame, read when it retires, null when
+  // the graphics queue has no timestamps
+  VkQueryPool timestamps = VK_NULL_HANDLE;
+  uint32_t timestamp_capacity = 0, timestamp_count = 0;
+  std::uint64_t timestamp_frame = 0;
+  // time spent waiting for the graphics queue lock at submission
+  std::chrono::nanoseconds queue_wait {0};
+  // one pool for each thread recording regions besides the render
+  // thread, a command pool is only used by one thread at a time
+  std::vector<VkCommandPool> worker_pools;
+  std::vector<std::vector<VkCommandBuffer>> worker_command_buffers;
+  // what the frame reports once its fence signals
+  std::uint64_t sequence = 0, scene = 0;
+  frame_scheduler::clock::time_point started, target;
+  std::chrono::nanoseconds recording {0};
+  bool read_back = false;
+  // VkPresentTimeGOOGLE id the frame was presented with
+  uint32_t present_id = 0;
+};
+
+std::vector<render_frame_context> render_thread_create_frame_contexts (VkDevice device, uint32_t queue_family
+                                                                       , std::size_t size)
+{
+  std::vector<render_frame_context> frames;
+  frames.reserve (size);
+  for (std::size_t i = 0; i != size; ++i)
+  {
+    frames.push_back ({render_thread_create_semaphore (device)
+                       , render_thread_create_semaphore (device)
+                       , render_thread_create_fence (device), false
+                       , render_thread_create_command_pool (device, queue_family), {}});
+  }
+  return frames;
+}
+
+// returns count primary command buffers from command_pool, allocating
+// only the ones previous frames did not need
+VkCommandBuffer* render_thread_pool_command_buffers (VkDevice device, VkCommandPool command_pool
+                                                     , std::vector<VkCommandBuffer>& command_buffers
+                                                     , std::size_t count)
+{
+  using fastdraw::output::vulkan::from_result;
+  using fastdraw::output::vulkan::vulkan_error_code;
+  if (command_buffers.size() < count)
+  {
+    auto allocated = command_buffers.size();
+    command_buffers.resize (count);
+
+    VkCommandBufferAllocateInfo allocInfo = {};
+    allocInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO;
+    allocInfo.commandPool = command_pool;
+    allocInfo.level = VK_COMMAND_BUFFER_LEVEL_PRIMARY;
+    allocInfo.commandBufferCount = count - allocated;
+
+    auto r = from_result (vkAllocateCommandBuffers(device, &allocInfo, &command_buffers[allocated]));
+    if (r != vulkan_error_code::success)
+    {
+      command_buffers.resize (allocated);
+      throw std::system_error(make_error_code (r));
+    }
+  }
+  return command_buffers.data();
+}
+
+VkCommandBuffer* render_thread_frame_command_buffers (VkDevice device, render_frame_context& frame, std::size_t count)
+{
+  return render_thread_pool_command_buffers (device, frame.command_pool, frame.command_buffers, count);
+}
+
+void render_thread_create_worker_pools (VkDevice device, std::vector<render_frame_context>& frames
+                                        , uint32_t queue_family, std::size_t workers)
+{
+  for (auto&& frame : frames)
+  {
+    frame.worker_command_buffers.resize (workers);
+    while (frame.worker_pools.size() != workers)
+      frame.worker_pools.push_back (render_thread_create_command_pool (device, queue_family));
+  }
+}
+
+// the command buffers of count regions, region i is recorded by worker
+// i % workers, worker 0 being the render thread and recording from the
+// frame pool, which also gives the extra command buffers after them
+std::vector<VkCommandBuffer> render_thread_region_command_buffers (VkDevice device, render_frame_context& frame
+                                                                  , std::size_t count, std::size_t workers
+                                                                  , std::size_t extra)
+{
+  std::vector<VkCommandBuffer> command_buffers (count + extra);
+  std::size_t const own = (count + workers - 1) / workers;
+  auto const buffers = render_thread_frame_command_buffers (device, frame, own + extra);
+  for (std::size_t i = 0; i < count; i += workers)
+    command_buffers[i] = buffers[i / workers];
+  std::copy (buffers + own, buffers + own + extra, command_buffers.begin() + count);
+  for (std::size_t worker = 1; worker < workers; ++worker)
+  {
+    auto const worker_buffers = render_thread_pool_command_buffers
+      (device, frame.worker_pools[worker - 1], frame.worker_command_buffers[worker - 1]
+       , (count - worker + workers - 1) / workers);
+    for (std::size_t i = worker; i < count; i += workers)
+      command_buffers[i] = worker_buffers[i / workers];
+  }
+  return command_buffers;
+}
+
+void render_thread_destroy_frame_contexts (VkDevice device, std::vector<render_frame_context>& frames)
+{
+  for (auto&& frame : frames)
+  {
+    vkDestroySemaphore (device, frame.image_available, nullptr);
+    vkDestroySemaphore (device, frame.render_finished, nullptr);
+    vkDestroyFence (device, frame.execution_finished, nullptr);
+    vkDestroyCommandPool (device, frame.command_pool, nullptr);
+    for (auto command_pool : frame.worker_pools)
+      vkDestroyCommandPool (device, command_pool, nullptr);
+    if (frame.timestamps != VK_NULL_HANDLE)
+      vkDestroyQueryPool (device, frame.timestamps, nullptr);
+  }
+  frames.clear();
+}
+
+void render_thread_wait_fence (VkDevice device, VkFence fence)
+{
+  using fastdraw::output::vulkan::from_result;
+  using fastdraw::output::vulkan::vulkan_error_code;
+  auto r = from_result (vkWaitForFences (device, 1, &fence, VK_FALSE, UINT64_MAX));
+  if (r != vulkan_error_code::success)
+    throw std::system_error(make_error_code(r));
+}
+
+// true once the GPU is done with the frame, without waiting
+bool render_thread_frame_finished (VkDevice device, render_frame_context const& frame)
+{
+  using fastdraw::output::vulkan::from_result;
+  auto const result = vkGetFenceStatus (device, frame.execution_finished);
+  if (result == VK_NOT_READY)
+    return false;
+  if (result != VK_SUCCESS)
+    throw std::system_error(make_error_code (from_result (result)));
+  return true;
+}
+
+// waits until the GPU is done with this frame context so its
+// semaphores, fence and command buffers can be reused
+void render_thread_retire_frame (VkDevice device, render_frame_context& frame)
+{
+  if (!frame.in_flight)
+    return;
+
+  render_thread_wait_fence (device, frame.execution_finished);
+  vkResetFences (device, 1, &frame.execution_finished);
+  vkResetCommandPool (device, frame.command_pool, 0);
+  for (auto command_pool : frame.worker_pools)
+    vkResetCommandPool (device, command_pool, 0);
+  frame.in_flight = false;
+}
+
+// capacity timestamps for each frame context, three for each
+// recorded pass pair
+void render_thread_create_timestamp_pools (VkDevice device, std::vector<render_frame_context>& frames
+                                           , uint32_t capacity)
+{
+  using fastdraw::output::vulkan::from_result;
+  using fastdraw::output::vulkan::vulkan_error_code;
+  VkQueryPoolCreateInfo poolInfo = {};
+  poolInfo.sType = VK_STRUCTURE_TYPE_QUERY_POOL_CREATE_INFO;
+  poolInfo.queryType = VK_QUERY_TYPE_TIMESTAMP;
+  poolInfo.queryCount = capacity;
+
+  for (auto&& frame : frames)
+  {
+    auto r = from_result (vkCreateQueryPool (device, &poolInfo, nullptr, &frame.timestamps));
+    if (r != vulkan_error_code::success)
+      throw std::system_error(make_error_code(r));
+    frame.timestamp_capacity = capacity;
+  }
+}
+
+// after the frame's fence signaled, timestamps come in triples:
+// before the filler pass, between the passes and after the image pass
+std::optional<frame_timings> render_thread_collect_timestamps (VkDevice device, render_frame_context& frame
+                                                              , double period, uint64_t mask)
+{
+  if (!frame.timestamp_count)
+    return std::nullopt;
+
+  std::vector<uint64_t> ticks (frame.timestamp_count);
+  auto const result = vkGetQueryPoolResults (device, frame.timestamps, 0, frame.timestamp_count
+                                             , ticks.size() * sizeof(uint64_t), ticks.data()
+                                             , sizeof(uint64_t), VK_QUERY_RESULT_64_BIT);
+  frame.timestamp_count = 0;
+  if (result != VK_SUCCESS)
+    return std::nullopt;
+
+  auto const elapsed = [&] (uint64_t begin, uint64_t end)
+                       {
+                         return std::chrono::nanoseconds
+                           (static_cast<std::int64_t>(((end - begin) & mask) * period));
+                       };
+  frame_timings timings {frame.timestamp_frame, {}, {}, elapsed (ticks.front(), ticks.back()), {}
+                         , frame.queue_wait};
+  for (std::size_t i = 0; i + 2 < ticks.size(); i += 3)
+  {
+    timings.filler += elapsed (ticks[i], ticks[i + 1]);
+    timings.image += elapsed (ticks[i + 1], ticks[i + 2]);
+    timings.regions.push_back (elapsed (ticks[i], ticks[i + 2]));
+  }
+  return timings;
+}
+
+// returns false when no image became available before timeout
+bool render_thread_acquire_image (VkDevice device, VkSwapchainKHR swapchain, VkSemaphore image_available
+                                  , std::chrono::nanoseconds timeout, uint32_t& image_index)
+{
+  using fastdraw::output::vulkan::from_result;
+  using fastdraw::output::vulkan::vulkan_error_code;
+  auto result = vkAcquireNextImageKHR (device, swapchain, timeout.count(), image_available
+                                       , VK_NULL_HANDLE, &image_index);
+  if (result == VK_TIMEOUT || result == VK_NOT_READY)
+    return false;
+  if (result != VK_SUCCESS && result != VK_SUBOPTIMAL_KHR)
+    throw std::system_error(make_error_code (from_result (result)));
+  return true;
+}
+
+// vkGetDeviceProcAddr gives no VK_GOOGLE_display_timing command unless
+// the device was created with the extension
+bool render_thread_display_timing_enabled (VkDevice device)
+{
+  return vkGetDeviceProcAddr (device, "vkGetPastPresentationTimingGOOGLE")
+    && vkGetDeviceProcAddr (device, "vkGetRefreshCycleDurationGOOGLE");
+}
+
+// the presentation engine reports times in CLOCK_MONOTONIC, the clock
+// steady_clock uses. presented is called with the id and the time of
+// every frame shown since the last call, in order
+template <typename F>
+void render_thread_feed_display_timing (VkDevice device, VkSwapchainKHR swapchain
+                                        , frame_scheduler& scheduler, F presented)
+{
+  auto static const vkGetPastPresentationTimingGOOGLE
+    = reinterpret_cast<PFN_vkGetPastPresentationTimingGOOGLE>
+    (vkGetDeviceProcAddr (device, "vkGetPastPresentationTimingGOOGLE"));
+  if (!vkGetPastPresentationTimingGOOGLE)
+    return;
+
+  uint32_t count = 0;
+  vkGetPastPresentationTimingGOOGLE (device, swapchain, &count, nullptr);
+  std::vector<VkPastPresentationTimingGOOGLE> timings (count);
+  vkGetPastPresentationTimingGOOGLE (device, swapchain, &count, timings.data());
+  timings.resize (count);
+  for (auto&& timing : timings)
+  {
+    frame_scheduler::clock::time_point const time
+      (std::chrono::duration_cast<frame_scheduler::clock::duration>
+       (std::chrono::nanoseconds (timing.actualPresentTime)));
+    scheduler.presented (time);
+    presented (timing.presentID, time);
+  }
+}
+
+void render_thread_query_refresh (VkDevice device, VkSwapchainKHR swapchain, frame_scheduler& scheduler)
+{
+  auto static const vkGetRefreshCycleDurationGOOGLE
+    = reinterpret_cast<PFN_vkGetRefreshCycleDurationGOOGLE>
+    (vkGetDeviceProcAddr (device, "vkGetRefreshCycleDurationGOOGLE"));
+  if (!vkGetRefreshCycleDurationGOOGLE)
+    return;
+
+  VkRefreshCycleDurationGOOGLE refresh = {};
+  if (vkGetRefreshCycleDurationGOOGLE (device, swapchain, &refresh) == VK_SUCCESS)
+    scheduler.refresh (std::chrono::nanoseconds (refresh.refreshDuration));
+}
+
+template <typename Region>
+VkRect2D render_thread_render_area (Region const& region, VkExtent2D extent)
+{
+  auto x = region.x;
+  auto y = region.y;
+  auto width = static_cast<uint32_t>(region.width);
+  auto height = static_cast<uint32_t>(region.height);
+
+  auto w = static_cast<uint32_t>(x) + width <= extent.width
+    ? width : extent.width - static_cast<uint32_t>(x);
+  auto h = static_cast<uint32_t>(y) + height <= extent.height
+    ? height : extent.height - static_cast<uint32_t>(y);
+  return {{x, y}, {w, h}};
+}
+
+// the render area of single_pass mode. It covers the gaps between the
+// damaged regions too, so voutput.renderpass must load the color
+// attachment (VK_ATTACHMENT_LOAD_OP_LOAD) or the gaps are cleared
+VkRect2D render_thread_bounding_area (std::vector<VkRect2D> const& areas)
+{
+  assert (!areas.empty());
+  int32_t x1 = areas.front().offset.x, y1 = areas.front().offset.y;
+  int32_t x2 = x1 + areas.front().extent.width, y2 = y1 + areas.front().extent.height;
+  for (auto&& area : areas)
+  {
+    x1 = std::min (x1, area.offset.x);
+    y1 = std::min (y1, area.offset.y);
+    x2 = std::max (x2, static_cast<int32_t>(area.offset.x + area.extent.width));
+    y2 = std::max (y2, static_cast<int32_t>(area.offset.y + area.extent.height));
+  }
+  return {{x1, y1}, {static_cast<uint32_t>(x2 - x1), static_cast<uint32_t>(y2 - y1)}};
+}
+
+void render_thread_begin_command_buffer (VkCommandBuffer command_buffer)
+{
+  using fastdraw::output::vulkan::from_result;
+  using fastdraw::output::vulkan::vulkan_error_code;
+  VkCommandBufferBeginInfo beginInfo = {};
+  beginInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO;
+  beginInfo.flags = VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT;
+  auto r = from_result (vkBeginCommandBuffer(command_buffer, &beginInfo));
+  if (r != vulkan_error_code::success)
+    throw std::system_error(make_error_code(r));
+
+  // previous frames may still be in flight, order the indirect
+  // buffer resets they recorded before this frame's filler pass
+  VkMemoryBarrier memory_barrier = {VK_STRUCTURE_TYPE_MEMORY_BARRIER};
+  memory_barrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+  memory_barrier.dstAccessMask = VK_ACCESS_SHADER_READ_BIT | VK_ACCESS_SHADER_WRITE_BIT
+    | VK_ACCESS_INDIRECT_COMMAND_READ_BIT;
+  vkCmdPipelineBarrier (command_buffer, VK_PIPELINE_STAGE_TRANSFER_BIT
+                        , VK_PIPELINE_STAGE_DRAW_INDIRECT_BIT
+                        | VK_PIPELINE_STAGE_VERTEX_SHADER_BIT
+                        | VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT, 0
+                        , 1, &memory_barrier, 0, nullptr, 0, nullptr);
+}
+
+void render_thread_end_command_buffer (VkCommandBuffer command_buffer)
+{
+  using fastdraw::output::vulkan::from_result;
+  using fastdraw::output::vulkan::vulkan_error_code;
+  auto r = from_result (vkEndCommandBuffer(command_buffer));
+  if (r != vulkan_error_code::success)
+    throw std::system_error(make_error_code(r));
+}
+
+// makes the indirect buffer written by the filler pass visible to the
+// composition pass, recorded outside of any render pass
+void render_thread_indirect_filled_barrier (VkCommandBuffer command_buffer)
+{
+  VkMemoryBarrier memory_barrier = {VK_STRUCTURE_TYPE_MEMORY_BARRIER};
+  memory_barrier.srcAccessMask = VK_ACCESS_SHADER_WRITE_BIT;
+  memory_barrier.dstAccessMask = VK_ACCESS_SHADER_READ_BIT | VK_ACCESS_INDIRECT_COMMAND_READ_BIT;
+
+  vkCmdPipelineBarrier (command_buffer, VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT
+                        , VK_PIPELINE_STAGE_DRAW_INDIRECT_BIT
+                        | VK_PIPELINE_STAGE_VERTEX_INPUT_BIT
+                        | VK_PIPELINE_STAGE_VERTEX_SHADER_BIT
+                        | VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT, 0
+                        , 1, &memory_barrier, 0, nullptr, 0, nullptr);
+}
+
+// the filler pass of a slot reset earlier in the same submission sees
+// the reset
+void render_thread_indirect_reset_barrier (VkCommandBuffer command_buffer)
+{
+  VkMemoryBarrier memory_barrier = {VK_STRUCTURE_TYPE_MEMORY_BARRIER};
+  memory_barrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+  memory_barrier.dstAccessMask = VK_ACCESS_SHADER_READ_BIT | VK_ACCESS_SHADER_WRITE_BIT;
+
+  vkCmdPipelineBarrier (command_buffer, VK_PIPELINE_STAGE_TRANSFER_BIT
+                        , VK_PIPELINE_STAGE_VERTEX_SHADER_BIT | VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT, 0
+                        , 1, &memory_barrier, 0, nullptr, 0, nullptr);
+}
+
+// puts the indirect draw info at offset back to the state the filler
+// pass expects: vertex count kept, counters and buffers to draw zeroed
+// and fg_zindex filled with 0xFFFFFFFF. Only the first entries of each
+// array are reset, the rest was left untouched since the last reset
+void render_thread_reset_indirect_slot (VkCommandBuffer command_buffer, VkBuffer indirect_draw_buffer
+                                        , VkDeviceSize offset, std::size_t entries = 4096)
+{
+  vkCmdFillBuffer (command_buffer, indirect_draw_buffer
+                   , offset + sizeof(uint32_t), (5 + entries) * sizeof(uint32_t), 0);
+
+  if (entries)
+    vkCmdFillBuffer (command_buffer, indirect_draw_buffer
+                     , offset + sizeof(uint32_t) * (6 + 4096), entries * sizeof(uint32_t), 0xFFFFFFFF);
+}
   
 }
+
+enum class render_mode
+{
+  // one command buffer with a filler and a composition render pass for
+  // each damaged region
+  region_passes
+  // all damaged regions in one command buffer, scissored inside a
+  // single filler pass and a single composition pass. Only valid when
+  // voutput.renderpass loads the color attachment, see
+  // detail::render_thread_bounding_area
+  , single_pass
+};
+
+struct render_options
+{
+  render_mode mode = render_mode::region_passes;
+
+  // how many frames may be recorded and queued before the render
+  // thread waits for the GPU, clamped to the swapchain image count
+  std::size_t frames_in_flight = 2;
+
+  // damage is drawn as its bounding box when it is split in more rects
+  // than this or when each extra rect costs more than the pixels it
+  // saves, damage_rect_cost being the overhead of one rect in pixels
+  std::size_t max_damage_rects = 32;
+  std::int64_t damage_rect_cost = 64 * 64;
+
+  // passes the frame damage to vkQueuePresentKHR, only valid when the
+  // device was created with VK_KHR_incremental_present, see
+  // detail::render_thread_has_device_extension
+  bool incremental_present = false;
+
+  // composition starts shortly before the predicted vblank instead of
+  // as soon as something is damaged
+  frame_scheduler_options scheduling;
+
+  // feeds the scheduler with the refresh duration and the actual
+  // present times, and reports frames to feedback with the time they
+  // were shown at instead of a prediction. Ignored unless the device
+  // was created with VK_GOOGLE_display_timing
+  bool display_timing = false;
+
+  // numbers the frames and reports when they were presented, so
+  // clients are throttled to what is actually shown
+  presentation_feedback* feedback = nullptr;
+
+  // held by every frame from taking its scene until it retires, must
+  // be given whenever the loop thread changes the toplevel while the
+  // render thread runs
+  scene_gate* gate = nullptr;
+
+  // the frame composed in this position, counting from 1, is copied
+  // back and written to readback_path as a PNG, 0 reads back nothing.
+  // See frame_readback::check_format for the formats supported
+  std::uint64_t readback_frame = 0;
+  std::filesystem::path readback_path;
+
+  // GPU time of the filler and image passes of every frame, measured
+  // with timestamp queries when the graphics queue supports them
+  render_metrics* metrics = nullptr;
+
+  // in region_passes mode, the damaged regions are recorded by the
+  // render thread and recording_threads more workers posted here, each
+  // with its own command pools. Empty records on the render thread only.
+  // Frames wait for the workers, so the executor should not be shared
+  // with long tasks such as uploads; workers it has not started in time
+  // are recorded by the render thread
+  std::function<void(std::function<void()>)> recording_executor;
+  std::size_t recording_threads = 3;
+};
   
 template <typename Backend>
-std::thread render_thread (ftk::ui::toplevel_window<Backend>* toplevel, bool& dirty, bool& exit, std::mutex& mutex, std::condition_variable& cond)
+std::thread render_thread (ftk::ui::toplevel_window<Backend>* toplevel, render_queue& queue
+                           , render_options options = {})
 {
   std::thread thread
-    ([toplevel, &dirty, &exit, &mutex, &cond]
+    ([toplevel, &queue, options]
      {
        auto last_time = std::chrono::high_resolution_clock::now();
        using fastdraw::output::vulkan::from_result;
@@ -96,35 +654,66 @@ std::thread render_thread (ftk::ui::toplevel_window<Backend>* toplevel, bool& di
        auto const indirect_pipeline = ftk::ui::vulkan
          ::create_indirect_draw_buffer_filler_pipeline (toplevel->window.voutput);
 
+       auto const image_count = detail::render_thread_swapchain_image_count
+         (toplevel->window.voutput.device, toplevel->window.swapChain);
+       auto frames = detail::render_thread_create_frame_contexts
+         (toplevel->window.voutput.device
+          , detail::render_thread_graphics_queue_family (toplevel->window.voutput.physical_device)
+          , std::max<std::size_t>(1, std::min<std::size_t>(options.frames_in_flight, image_count)));
+       bool const parallel_recording = options.mode == render_mode::region_passes
+         && options.recording_executor && options.recording_threads;
+       if (parallel_recording)
+         detail::render_thread_create_worker_pools
+           (toplevel->window.voutput.device, frames
+            , detail::render_thread_graphics_queue_family (toplevel->window.voutput.physical_device)
+            , options.recording_threads);
+
+       // timestamps measure the render time the scheduler needs, not
+       // only the metrics
+       double timestamp_period = 0;
+       uint64_t timestamp_mask = 0;
+       {
+         VkPhysicalDeviceProperties properties;
+         vkGetPhysicalDeviceProperties (toplevel->window.voutput.physical_device, &properties);
+         uint32_t family_count = 0;
+         vkGetPhysicalDeviceQueueFamilyProperties (toplevel->window.voutput.physical_device, &family_count, nullptr);
+         std::vector<VkQueueFamilyProperties> families (family_count);
+         vkGetPhysicalDeviceQueueFamilyProperties (toplevel->window.voutput.physical_device, &family_count
+                                                   , families.data());
+         auto const valid_bits = families[detail::render_thread_graphics_queue_family
+                                          (toplevel->window.voutput.physical_device)].timestampValidBits;
+         if (valid_bits)
+         {
+           timestamp_period = properties.limits.timestampPeriod;
+           timestamp_mask = valid_bits == 64 ? ~uint64_t(0) : (uint64_t(1) << valid_bits) - 1;
+           detail::render_thread_create_timestamp_pools
+             (toplevel->window.voutput.device, frames
+              , 3 * std::max<uint32_t>(1, std::min<std::size_t>(options.max_damage_rects
+                                                                 , toplevel->indirect_draw_info_array_size)));
+         }
+       }
+       auto const collect_timestamps
+         = [&] (detail::render_frame_context& frame)
+           {
+             auto timings = detail::render_thread_collect_timestamps
+               (toplevel->window.voutput.device, frame, timestamp_period, timestamp_mask);
+             if (timings && options.metrics)
+               options.metrics->record (*timings);
+             return timings;
+           };
+
        // auto static const compute_pipeline = ftk::ui::vulkan
        //   ::create_initialize_draw_buffer_pipeline (toplevel->window.voutput);
        // initialize indirect buffer
        {
-         VkFence initialization_fence;
-         VkFenceCreateInfo fenceInfo = {};
-         fenceInfo.sType = VK_STRUCTURE_TYPE_FENCE_CREATE_INFO;
-         auto r = from_result (vkCreateFence (toplevel->window.voutput.device, &fenceInfo, nullptr, &initialization_fence));
-         if (r != vulkan_error_code::success)
-           throw std::system_error(make_error_code(r));
-
-         VkCommandPool command_pool = toplevel->window.voutput.command_pool;
-         VkCommandBuffer command_buffer;
-
-         VkCommandBufferAllocateInfo allocInfo = {};
-         allocInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO;
-         allocInfo.commandPool = command_pool;
-         allocInfo.level = VK_COMMAND_BUFFER_LEVEL_PRIMARY;
-         allocInfo.commandBufferCount = 1;
-
-         r = from_result (vkAllocateCommandBuffers(toplevel->window.voutput.device, &allocInfo
-                                                          , &command_buffer));
-         if (r != vulkan_error_code::success)
-           throw std::system_error(make_error_code (r));
+         auto& frame = frames.front();
+         VkCommandBuffer command_buffer = *detail::render_thread_frame_command_buffers
+           (toplevel->window.voutput.device, frame, 1);
 
          VkCommandBufferBeginInfo beginInfo = {};
          beginInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO;
          beginInfo.flags = VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT;
-         r = from_result (vkBeginCommandBuffer(command_buffer, &beginInfo));
+         auto r = from_result (vkBeginCommandBuffer(command_buffer, &beginInfo));
          if (r != vulkan_error_code::success)
            throw std::system_error(make_error_code(r));
 
@@ -156,291 +745,557 @@ std::thread render_thread (ftk::ui::toplevel_window<Backend>* toplevel, bool& di
 
          {
            ftk::ui::backend::vulkan_queues::lock_graphic_queue lock_queue(toplevel->window.queues);
-           r = from_result(vkQueueSubmit(lock_queue.get_queue().vkqueue, 1, &submitInfo, initialization_fence));
+           r = from_result(vkQueueSubmit(lock_queue.get_queue().vkqueue, 1, &submitInfo, frame.execution_finished));
          }
          if (r != vulkan_error_code::success)
            throw std::system_error(make_error_code (r));
+         frame.in_flight = true;
 
-         if (vkWaitForFences (toplevel->window.voutput.device, 1, &initialization_fence, VK_FALSE, -1) == VK_TIMEOUT)
-         {
-           //std::cout << "Timeout waiting for fence" << std::endl;
-           throw -1;
-         }
-         vkFreeCommandBuffers (toplevel->window.voutput.device, command_pool, 1, &command_buffer);
-         vkDestroyFence (toplevel->window.voutput.device, initialization_fence, nullptr);
+         detail::render_thread_retire_frame (toplevel->window.voutput.device, frame);
        }
+
+       std::size_t frame_index = 0;
+       // frame context last rendering to each swapchain image. Its fence
+       // is reset once it retires, so it is only waited for through the
+       // context while it is still in flight
+       std::vector<detail::render_frame_context*> images_in_flight (image_count, nullptr);
+       vwm::damage_history history (image_count, image_count + 1);
        
-       VkFence executionFinished[2];
-       VkFenceCreateInfo fenceInfo = {};
-       fenceInfo.sType = VK_STRUCTURE_TYPE_FENCE_CREATE_INFO;
-       auto r = from_result (vkCreateFence (toplevel->window.voutput.device, &fenceInfo, nullptr, &executionFinished[0]));
-       if (r != vulkan_error_code::success)
-         throw std::system_error(make_error_code(r));
-       r = from_result(vkCreateFence (toplevel->window.voutput.device, &fenceInfo, nullptr, &executionFinished[1]));
-       if (r != vulkan_error_code::success)
-         throw std::system_error(make_error_code(r));
-       
+       vwm::frame_scheduler scheduler (options.scheduling);
+       bool const display_timing = options.display_timing
+         && detail::render_thread_display_timing_enabled (toplevel->window.voutput.device);
+       if (options.display_timing && !display_timing)
+         VWM_LOG (warning, render, "VK_GOOGLE_display_timing is not enabled on the device");
+       if (display_timing)
+         detail::render_thread_query_refresh (toplevel->window.voutput.device, toplevel->window.swapChain
+                                              , scheduler);
+       uint32_t present_id = 0;
+       std::uint64_t frame_number = 0;
+       // created up front so the frame read back is recorded like any
+       // other, released once written
+       std::unique_ptr<vwm::frame_readback> readback;
+       if (options.readback_frame)
+         readback.reset (new vwm::frame_readback
+                         (toplevel->window.voutput.device, toplevel->window.voutput.physical_device
+                          , toplevel->window.voutput.swapChainExtent
+                          , toplevel->window.voutput.swapChainImageFormat
+                          , toplevel->window.voutput.renderpass));
+       vwm::scene frame_scene;
+
+       bool exit = false;
+       // scenes pushed since the last frame merged into one
+       std::unique_ptr<vwm::scene> pending;
+       auto const drain
+         = [&]
+           {
+             while (auto operation = queue.pop())
+             {
+               if (auto* s = std::get_if<std::unique_ptr<vwm::scene>>(&*operation))
+               {
+                 if (pending)
+                   (*s)->damage.unite (pending->damage);
+                 pending = std::move (*s);
+               }
+               else
+                 exit = true;
+             }
+           };
+
+       // with display timing, frames are reported once the presentation
+       // engine gives the time they were shown at. A frame it skips, or
+       // does not give within a few refreshes, is reported with the
+       // predicted time
+       std::deque<std::pair<uint32_t, vwm::presented_frame>> unpresented;
+       auto const report_presented
+         = [&]
+           {
+             detail::render_thread_feed_display_timing
+               (toplevel->window.voutput.device, toplevel->window.swapChain, scheduler
+                , [&] (uint32_t id, frame_scheduler::clock::time_point time)
+                  {
+                    for (; !unpresented.empty() && unpresented.front().first <= id; unpresented.pop_front())
+                    {
+                      auto presented = unpresented.front().second;
+                      if (unpresented.front().first == id)
+                      {
+                        presented.time = time;
+                        presented.msc = scheduler.sequence (time);
+                        presented.exact = true;
+                      }
+                      options.feedback->frame_presented (presented);
+                    }
+                  });
+             auto const late = frame_scheduler::clock::now() - scheduler.refresh() * 4;
+             for (; !unpresented.empty() && unpresented.front().second.time < late; unpresented.pop_front())
+               options.feedback->frame_presented (unpresented.front().second);
+           };
+
+       // the render time, the readback and the presentation of a frame
+       // are only known once its fence signaled. The render time is the
+       // recording time plus the GPU time from the timestamps, or up to
+       // when the fence was seen signaled without timestamps. Nothing is
+       // reported after the loop exits, the uv loop may be gone
+       auto const retire
+         = [&] (detail::render_frame_context& frame, bool report = true)
+           {
+             if (!frame.in_flight)
+               return;
+             detail::render_thread_wait_fence (toplevel->window.voutput.device, frame.execution_finished);
+             auto const now = frame_scheduler::clock::now();
+             auto const timings = collect_timestamps (frame);
+             auto const render_time = timings ? frame.recording + timings->total
+               : std::chrono::duration_cast<std::chrono::nanoseconds> (now - frame.started);
+             scheduler.frame_finished (frame.started, render_time);
+             if (frame.read_back)
+             {
+               readback->write_png (options.readback_path);
+               readback.reset();
+               VWM_LOG (info, render, "Frame " << options.readback_frame << " written to " << options.readback_path);
+             }
+             if (report && options.feedback)
+             {
+               // a frame done after its target vblank is shown later
+               auto const time = scheduler.vblank_after (std::max (frame.target, frame.started + render_time));
+               vwm::presented_frame const presented {frame.sequence, frame.scene, time, scheduler.refresh()
+                                                     , scheduler.sequence (time)};
+               if (display_timing)
+                 unpresented.push_back ({frame.present_id, presented});
+               else
+                 options.feedback->frame_presented (presented);
+             }
+             if (report && display_timing)
+               report_presented ();
+             detail::render_thread_retire_frame (toplevel->window.voutput.device, frame);
+             if (options.gate)
+               options.gate->release();
+           };
+       // frames retire in the order they were submitted, frame_index
+       // being the context submitted the longest ago
+       auto const oldest_in_flight
+         = [&] () -> detail::render_frame_context*
+           {
+             for (std::size_t i = 0; i != frames.size(); ++i)
+               if (frames[(frame_index + i) % frames.size()].in_flight)
+                 return &frames[(frame_index + i) % frames.size()];
+             return nullptr;
+           };
+       auto const retire_finished
+         = [&]
+           {
+             while (auto frame = oldest_in_flight())
+             {
+               if (!detail::render_thread_frame_finished (toplevel->window.voutput.device, *frame))
+                 break;
+               retire (*frame);
+             }
+           };
+       // sleeps until a push or the deadline, returning false once the
+       // deadline passed. It also wakes up when the oldest frame in
+       // flight should be done, so it is reported without waiting for
+       // the GPU in lockstep nor for the next frame
+       auto const wait_for_scenes
+         = [&] (std::optional<frame_scheduler::clock::time_point> deadline)
+           {
+             for (;;)
+             {
+               retire_finished();
+               if (!unpresented.empty())
+                 report_presented ();
+               auto wake = deadline;
+               if (auto frame = oldest_in_flight())
+               {
+                 auto const done = std::max (frame->started + scheduler.render_time()
+                                             , frame_scheduler::clock::now() + std::chrono::microseconds (500));
+                 if (!wake || done < *wake)
+                   wake = done;
+               }
+               // polled for the presentation engine's time of the oldest
+               // frame not reported yet
+               if (!unpresented.empty())
+               {
+                 auto const due = std::max (unpresented.front().second.time
+                                            , frame_scheduler::clock::now() + std::chrono::milliseconds (1));
+                 if (!wake || due < *wake)
+                   wake = due;
+               }
+               if (queue.wait (wake))
+                 return true;
+               if (deadline && frame_scheduler::clock::now() >= *deadline)
+                 return false;
+             }
+           };
+
        while (!exit)
        {
          uint32_t imageIndex;
-         VkSemaphore imageAvailable, renderFinished;
-         imageAvailable = detail::render_thread_create_semaphore (toplevel->window.voutput.device);
-         renderFinished = detail::render_thread_create_semaphore (toplevel->window.voutput.device);
-         // std::cout << "render thread waiting to render (before lock)" << std::endl;
-         std::unique_lock<std::mutex> l(mutex);
+         auto& frame = frames[frame_index];
+         retire (frame);
+         VkSemaphore imageAvailable = frame.image_available, renderFinished = frame.render_finished;
          // std::cout << "render thread waiting to render" << std::endl;
-         imageIndex = -1;
-         while ((!dirty || imageIndex == std::numeric_limits<uint32_t>::max()) && !exit)
+         drain();
+         while (!pending && !exit)
          {
-           // std::cout << "not dirty and not exit" << std::endl;
-           if (imageIndex == std::numeric_limits<uint32_t>::max())
-           {
-             l.unlock();
-             vkAcquireNextImageKHR(toplevel->window.voutput.device, toplevel->window.swapChain
-                                   , std::numeric_limits<uint64_t>::max(), imageAvailable
-                                   , /*toplevel->window.executionFinished*/nullptr, &imageIndex);
-             std::cout << "Acquired image index " << imageIndex << std::endl;
-             {
-               auto now = std::chrono::high_resolution_clock::now();
-               auto diff = now - last_time;
-               last_time = now;
-               std::cout << "Time between frames "
-                         << std::chrono::duration_cast<std::chrono::milliseconds>(diff).count()
-                         << "ms" << std::endl;
-             }
-             l.lock();
-           }
-           if (!dirty && !exit)
-             cond.wait(l);
-           // std::cout << "condvar wake up" << std::endl;
+           wait_for_scenes (std::nullopt);
+           drain();
          }
          if (exit) break;
-         if (dirty == true)
-           dirty = false;
 
-         /**** acquire data ****/
-         // std::cout << "drawing" << std::endl;
-
-         // decltype (toplevel->images) images;
-
-         auto framebuffer_damaged_regions = std::move (toplevel->framebuffers_damaged_regions[imageIndex]);
-         assert (toplevel->framebuffers_damaged_regions[imageIndex].empty());
-
-         if (framebuffer_damaged_regions.size() > 32)
+         // scenes pushed until the deadline are drawn in this frame
+         auto const deadline = scheduler.deadline (frame_scheduler::clock::now());
+         while (!exit && wait_for_scenes (deadline))
+           drain();
+         if (exit) break;
+         frame.started = frame_scheduler::clock::now();
+         scheduler.frame_started (frame.started);
+         frame.target = scheduler.target_vblank();
+
+         // the image is acquired only now, so a frame does not hold an
+         // image while it waits for damage
+         while (!detail::render_thread_acquire_image
+                (toplevel->window.voutput.device, toplevel->window.swapChain, imageAvailable
+                 , scheduler.refresh() * 4, imageIndex))
          {
-           auto first = std::next (framebuffer_damaged_regions.begin(), 32)
-             , last = framebuffer_damaged_regions.end();
-           for (;first != last; ++first)
-           {
-             toplevel->framebuffers_damaged_regions[imageIndex].push_back (std::move(*first));
-           }
-           framebuffer_damaged_regions.erase (first, last);
+           drain();
+           if (exit) break;
          }
-
-         unsigned int i = 0;
-         for (auto&& image : toplevel->components)
+         if (exit) break;
+         VWM_LOG (trace, render, "Acquired image index " << imageIndex);
          {
-           if (image.must_draw[imageIndex])
-           {
-             std::cout << "found drawable image " << &image << " image.must_draw[0] "
-                       << image.must_draw[0] << " image.must_draw[1] " << image.must_draw[1] << std::endl;
-             // images.push_back(image);
-             image.must_draw[imageIndex] = false;
-             image.framebuffers_regions[imageIndex] = {image.x, image.y, image.width, image.height};
-             if (framebuffer_damaged_regions.size() < 32)
-               framebuffer_damaged_regions.push_back
-                 ({image.x, image.y, image.width, image.height});
-             else
-               toplevel->framebuffers_damaged_regions[imageIndex].push_back
-                 ({image.x, image.y, image.width, image.height});
-           }
-           i++;
+           auto now = std::chrono::high_resolution_clock::now();
+           auto diff = now - last_time;
+           last_time = now;
+           VWM_LOG (trace, render, "Time between frames "
+                     << std::chrono::duration_cast<std::chrono::milliseconds>(diff).count()
+                     << "ms");
          }
+         // the toplevel does not change under the scene taken now until
+         // this frame retires, and changes queued on the gate run once
+         // the frames in flight retired
+         if (options.gate)
+           while (!options.gate->try_use())
+             retire (*oldest_in_flight());
+         drain();
+         frame_scene = std::move (*pending);
+         pending.reset();
+         // the scenes drained are merged into the last one, so every
+         // scene up to its number is drawn by this frame
+         frame.sequence = ++frame_number;
+         frame.scene = frame_scene.sequence;
+         bool const read_back = frame.read_back = frame_number == options.readback_frame;
+
+         // the image may have been acquired ahead of a frame context
+         // that is still rendering to it, frames retire in order
+         if (auto owner = images_in_flight[imageIndex]; owner && owner != &frame)
+           while (owner->in_flight)
+             retire (*oldest_in_flight());
+         images_in_flight[imageIndex] = &frame;
+
+         /**** acquire data ****/
+         // std::cout << "drawing" << std::endl;
+
+         // the scene damage is all new damage for this frame, the age
+         // of each image is tracked by damage_history
+         auto const& damage = frame_scene.damage;
+         vwm::rect const extents {0, 0, static_cast<int32_t>(toplevel->window.voutput.swapChainExtent.width)
+                                  , static_cast<int32_t>(toplevel->window.voutput.swapChainExtent.height)};
+         // each rect takes one indirect draw slot
+         auto const max_damage_rects = std::min<std::size_t>
+           (options.max_damage_rects, toplevel->indirect_draw_info_array_size);
+         auto const framebuffer_damaged_regions = vwm::simplify
+           (history.frame_damage (imageIndex, damage, extents), max_damage_rects
+            , options.damage_rect_cost).rects();
+         // only what changed since the previous frame is reported to
+         // the presentation engine
+         std::vector<VkRectLayerKHR> present_rects;
+         if (options.incremental_present)
+           for (auto&& region : vwm::simplify (damage, max_damage_rects, options.damage_rect_cost).rects())
+             present_rects.push_back ({{region.x, region.y}
+                                       , {static_cast<uint32_t>(region.width), static_cast<uint32_t>(region.height)}, 0});
          // std::cout << "number of images to draw " << images.size() << std::endl;
 
-         //l.unlock();
-                         
          // first should create vertexbuffer for all, then record command buffer and then submitting
-         VkCommandPool commandPool = toplevel->window.voutput.command_pool;
-
-         std::vector<VkCommandBuffer> damaged_command_buffers;
+         std::size_t const damaged_command_buffer_count
+           = framebuffer_damaged_regions.empty() ? 0
+           : options.mode == render_mode::single_pass ? 1 : framebuffer_damaged_regions.size();
+         // regions go round robin to the workers, so none gets more
+         // than one extra
+         std::size_t const recording_workers = parallel_recording && damaged_command_buffer_count > 1
+           ? std::min (options.recording_threads + 1, damaged_command_buffer_count) : 1;
+         auto region_command_buffers = detail::render_thread_region_command_buffers
+           (toplevel->window.voutput.device, frame, damaged_command_buffer_count, recording_workers
+            , read_back);
+         VkCommandBuffer* damaged_command_buffers = region_command_buffers.data();
+
+         auto const indirect_draw_info_size = sizeof(typename ftk::ui::toplevel_window<Backend>::indirect_draw_info);
+         auto const bind_descriptors
+           = [&] (VkCommandBuffer command_buffer)
+             {
+               vkCmdBindDescriptorSets (command_buffer, VK_PIPELINE_BIND_POINT_GRAPHICS
+                                        , indirect_pipeline.pipeline_layout
+                                        , 0, 1, &frame_scene.texture_set
+                                        , 0, 0);
+
+               vkCmdBindDescriptorSets (command_buffer, VK_PIPELINE_BIND_POINT_GRAPHICS
+                                        , indirect_pipeline.pipeline_layout
+                                        , 1, 1, &frame_scene.sampler_set
+                                        , 0, 0);
+
+               uint32_t image_size = frame_scene.component_count;
+               vkCmdPushConstants(command_buffer
+                                  , indirect_pipeline.pipeline_layout
+                                  , VK_SHADER_STAGE_VERTEX_BIT
+                                  | VK_SHADER_STAGE_COMPUTE_BIT
+                                  | VK_SHADER_STAGE_FRAGMENT_BIT
+                                  , 0, sizeof(uint32_t), &image_size);
+             };
+         auto const push_slot_descriptors
+           = [&] (VkCommandBuffer command_buffer, std::size_t slot)
+             {
+               VkDescriptorBufferInfo ssboInfo = {};
+               ssboInfo.buffer = frame_scene.component_ssbo;
+               ssboInfo.range = VK_WHOLE_SIZE;
 
-         damaged_command_buffers.resize (framebuffer_damaged_regions.size());
-         
-         VkCommandBufferAllocateInfo allocInfo = {};
-         allocInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO;
-         allocInfo.commandPool = commandPool;
-         allocInfo.level = VK_COMMAND_BUFFER_LEVEL_PRIMARY;
-         allocInfo.commandBufferCount = damaged_command_buffers.size();
+               VkDescriptorBufferInfo indirect_draw_info = {};
+               indirect_draw_info.buffer = toplevel->indirect_draw_buffer;
+               indirect_draw_info.range = VK_WHOLE_SIZE;
+               indirect_draw_info.offset = slot*indirect_draw_info_size;
 
-         if (!damaged_command_buffers.empty())
-         {
-           auto r = from_result (vkAllocateCommandBuffers(toplevel->window.voutput.device, &allocInfo
-                                                          , &damaged_command_buffers[0]));
-           if (r != vulkan_error_code::success)
-             throw std::system_error(make_error_code (r));
-         }
+               VkWriteDescriptorSet descriptorWrites[2] = {};
+                             
+               descriptorWrites[0].sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
+               descriptorWrites[0].dstSet = 0;
+               descriptorWrites[0].dstBinding = 0;
+               descriptorWrites[0].descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
+               descriptorWrites[0].descriptorCount = 1;
+               descriptorWrites[0].pBufferInfo = &ssboInfo;
+
+               descriptorWrites[1].sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
+               descriptorWrites[1].dstSet = 0;
+               descriptorWrites[1].dstBinding = 2;
+               descriptorWrites[1].descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
+               descriptorWrites[1].descriptorCount = 1;
+               descriptorWrites[1].pBufferInfo = &indirect_draw_info;
+
+               vkCmdPushDescriptorSetKHR
+                 (command_buffer, VK_PIPELINE_BIND_POINT_GRAPHICS
+                  , indirect_pipeline.pipeline_layout
+                  , 2 /* from 1 */, sizeof(descriptorWrites)/sizeof(descriptorWrites[0]), &descriptorWrites[0]);
+
+               vkCmdPushDescriptorSetKHR
+                 (command_buffer, VK_PIPELINE_BIND_POINT_COMPUTE
+                  , indirect_pipeline.pipeline_layout
+                  , 2 /* from 1 */, sizeof(descriptorWrites)/sizeof(descriptorWrites[0]), &descriptorWrites[0]);
+             };
+
+         // outside render passes, in the first command buffer of the frame
+         auto const reset_timestamps
+           = [&] (VkCommandBuffer command_buffer)
+             {
+               if (frame.timestamps == VK_NULL_HANDLE)
+                 return;
+               vkCmdResetQueryPool (command_buffer, frame.timestamps, 0, frame.timestamp_capacity);
+               frame.timestamp_frame = frame_number;
+             };
+         auto const write_timestamp
+           = [&] (VkCommandBuffer command_buffer, VkPipelineStageFlagBits stage)
+             {
+               if (frame.timestamps != VK_NULL_HANDLE && frame.timestamp_count != frame.timestamp_capacity)
+                 vkCmdWriteTimestamp (command_buffer, stage, frame.timestamps, frame.timestamp_count++);
+             };
 
+         VkRenderPassBeginInfo renderPassInfo = {};
+         renderPassInfo.sType = VK_STRUCTURE_TYPE_RENDER_PASS_BEGIN_INFO;
+         renderPassInfo.framebuffer = toplevel->window.swapChainFramebuffers[imageIndex];
+         renderPassInfo.renderPass = toplevel->window.voutput.renderpass;
 
-         std::cout << "recording " << framebuffer_damaged_regions.size() << " regions" << std::endl;
-         // draw damage areas
-         i = 0;
-         for (auto&& region : framebuffer_damaged_regions)
+         VWM_LOG (trace, render, "recording " << framebuffer_damaged_regions.size() << " regions");
+         if (options.mode == render_mode::single_pass && !framebuffer_damaged_regions.empty())
          {
-           auto damaged_command_buffer = damaged_command_buffers[i];
-
-           auto x = region.x;
-           auto y = region.y;
-           auto width = static_cast<uint32_t>(region.width);
-           auto height = static_cast<uint32_t>(region.height);
-
-           std::cout << "damaged rect " << x << "x" << y << "-" << width << "x" << height << std::endl;
-           
-           VkRenderPassBeginInfo renderPassInfo = {};
-           renderPassInfo.sType = VK_STRUCTURE_TYPE_RENDER_PASS_BEGIN_INFO;
-           renderPassInfo.framebuffer = toplevel->window.swapChainFramebuffers[imageIndex];
-           renderPassInfo.renderArea.offset = {x, y};
-           {
-             auto w = static_cast<uint32_t>(x) + width <= toplevel->window.voutput.swapChainExtent.width
-               ? width : toplevel->window.voutput.swapChainExtent.width - static_cast<uint32_t>(x);
-             auto h = static_cast<uint32_t>(y) + height <= toplevel->window.voutput.swapChainExtent.height
-               ? height : toplevel->window.voutput.swapChainExtent.height - static_cast<uint32_t>(y);
-             renderPassInfo.renderArea.extent = {w/* + image.x*/, h/* + image.y*/};
-
-             std::cout << "rendering to " << renderPassInfo.renderArea.offset.x
-                       << "x" << renderPassInfo.renderArea.offset.y
-                       << " size " << renderPassInfo.renderArea.extent.width
-                       << "x" << renderPassInfo.renderArea.extent.height << std::endl;
-           }
-           renderPassInfo.renderPass = toplevel->window.voutput.renderpass;
-
-           VkCommandBufferBeginInfo beginInfo = {};
-           beginInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO;
-           beginInfo.flags = VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT;
-           auto r = from_result (vkBeginCommandBuffer(damaged_command_buffer, &beginInfo));
-           if (r != vulkan_error_code::success)
-             throw std::system_error(make_error_code(r));
-
-           {
-             VkDescriptorBufferInfo ssboInfo = {};
-             ssboInfo.buffer = toplevel->component_ssbo_buffer;
-             ssboInfo.range = VK_WHOLE_SIZE;
-
-             // VkDescriptorBufferInfo ssboZIndexInfo = {};
-             // ssboZIndexInfo.buffer = toplevel->image_zindex_ssbo_buffer;
-             // ssboZIndexInfo.range = VK_WHOLE_SIZE;
-
-             VkDescriptorBufferInfo indirect_draw_info = {};
-             indirect_draw_info.buffer = toplevel->indirect_draw_buffer;
-             indirect_draw_info.range = VK_WHOLE_SIZE;
-             indirect_draw_info.offset = i*sizeof(typename ftk::ui::toplevel_window<Backend>::indirect_draw_info);
-
-             std::cout << "offset of indirect draw info " << indirect_draw_info.offset << std::endl;
-             
-             VkWriteDescriptorSet descriptorWrites[2] = {};
-                             
-             descriptorWrites[0].sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
-             descriptorWrites[0].dstSet = 0;
-             descriptorWrites[0].dstBinding = 0;
-             descriptorWrites[0].descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
-             descriptorWrites[0].descriptorCount = 1;
-             descriptorWrites[0].pBufferInfo = &ssboInfo;
-
-             // descriptorWrites[1].sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
-             // descriptorWrites[1].dstSet = 0;
-             // descriptorWrites[1].dstBinding = 1;
-             // descriptorWrites[1].descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
-             // descriptorWrites[1].descriptorCount = 1;
-             // descriptorWrites[1].pBufferInfo = nullptr;//&ssboZIndexInfo;
-
-             descriptorWrites[1].sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
-             descriptorWrites[1].dstSet = 0;
-             descriptorWrites[1].dstBinding = 2;
-             descriptorWrites[1].descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
-             descriptorWrites[1].descriptorCount = 1;
-             descriptorWrites[1].pBufferInfo = &indirect_draw_info;
-             
-             vkCmdBindDescriptorSets (damaged_command_buffer, VK_PIPELINE_BIND_POINT_GRAPHICS
-                                      , indirect_pipeline.pipeline_layout
-                                      , 0, 1, &toplevel->texture_descriptors.set
-                                      , 0, 0);
-
-             vkCmdBindDescriptorSets (damaged_command_buffer, VK_PIPELINE_BIND_POINT_GRAPHICS
-                                      , indirect_pipeline.pipeline_layout
-                                      , 1, 1, &toplevel->sampler_descriptors.set
-                                      , 0, 0);
-
-             vkCmdPushDescriptorSetKHR
-               (damaged_command_buffer, VK_PIPELINE_BIND_POINT_GRAPHICS
-                , indirect_pipeline.pipeline_layout
-                , 2 /* from 1 */, sizeof(descriptorWrites)/sizeof(descriptorWrites[0]), &descriptorWrites[0]);
-
-             vkCmdPushDescriptorSetKHR
-               (damaged_command_buffer, VK_PIPELINE_BIND_POINT_COMPUTE
-                , indirect_pipeline.pipeline_layout
-                , 2 /* from 1 */, sizeof(descriptorWrites)/sizeof(descriptorWrites[0]), &descriptorWrites[0]);
-
-             uint32_t image_size = toplevel->components.size();
-             vkCmdPushConstants(damaged_command_buffer
-                                , indirect_pipeline.pipeline_layout
-                                , VK_SHADER_STAGE_VERTEX_BIT
-                                | VK_SHADER_STAGE_COMPUTE_BIT
-                                | VK_SHADER_STAGE_FRAGMENT_BIT
-                                , 0, sizeof(uint32_t), &image_size);
-           }
+           // every region is a scissor inside one filler pass and one
+           // composition pass covering their bounding box, the render
+           // pass loads the attachment so pixels outside the scissors
+           // are kept
+           auto damaged_command_buffer = damaged_command_buffers[0];
+           std::vector<VkRect2D> scissors;
+           scissors.reserve (framebuffer_damaged_regions.size());
+           for (auto&& region : framebuffer_damaged_regions)
+             scissors.push_back (detail::render_thread_render_area
+                                 (region, toplevel->window.voutput.swapChainExtent));
+           renderPassInfo.renderArea = detail::render_thread_bounding_area (scissors);
+
+           detail::render_thread_begin_command_buffer (damaged_command_buffer);
+           reset_timestamps (damaged_command_buffer);
+           write_timestamp (damaged_command_buffer, VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT);
+           bind_descriptors (damaged_command_buffer);
 
            vkCmdBeginRenderPass(damaged_command_buffer, &renderPassInfo, VK_SUBPASS_CONTENTS_INLINE);
            vkCmdBindPipeline(damaged_command_buffer, VK_PIPELINE_BIND_POINT_GRAPHICS, indirect_pipeline.pipeline);
-           VkRect2D scissor = renderPassInfo.renderArea;
-           vkCmdSetScissor (damaged_command_buffer, 0, 1, &scissor);
-
+           for (std::size_t slot = 0; slot != scissors.size(); ++slot)
+           {
+             push_slot_descriptors (damaged_command_buffer, slot);
+             vkCmdSetScissor (damaged_command_buffer, 0, 1, &scissors[slot]);
              vkCmdDraw(damaged_command_buffer, 6, 1, 0, 0);
+           }
+           vkCmdEndRenderPass(damaged_command_buffer);
+           write_timestamp (damaged_command_buffer, VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT);
 
-             VkMemoryBarrier memory_barrier = {VK_STRUCTURE_TYPE_MEMORY_BARRIER};
-             memory_barrier.srcAccessMask = VK_ACCESS_SHADER_WRITE_BIT;
-             memory_barrier.dstAccessMask = VK_ACCESS_SHADER_READ_BIT | VK_ACCESS_INDIRECT_COMMAND_READ_BIT;
-
-             vkCmdPipelineBarrier (damaged_command_buffer, VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT
-                                   , VK_PIPELINE_STAGE_DRAW_INDIRECT_BIT
-                                   | VK_PIPELINE_STAGE_VERTEX_INPUT_BIT
-                                   | VK_PIPELINE_STAGE_VERTEX_SHADER_BIT
-                                   | VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT, VK_DEPENDENCY_DEVICE_GROUP_BIT
-                                   , 1, &memory_barrier, 0, /*&buffer_barrier*/nullptr, 0, nullptr);
-
-             vkCmdEndRenderPass(damaged_command_buffer);
-             vkCmdBeginRenderPass(damaged_command_buffer, &renderPassInfo, VK_SUBPASS_CONTENTS_INLINE);
+           detail::render_thread_indirect_filled_barrier (damaged_command_buffer);
 
-             vkCmdBindPipeline(damaged_command_buffer, VK_PIPELINE_BIND_POINT_GRAPHICS, image_pipeline0.pipeline);
+           vkCmdBeginRenderPass(damaged_command_buffer, &renderPassInfo, VK_SUBPASS_CONTENTS_INLINE);
+           vkCmdBindPipeline(damaged_command_buffer, VK_PIPELINE_BIND_POINT_GRAPHICS, image_pipeline0.pipeline);
+           for (std::size_t slot = 0; slot != scissors.size(); ++slot)
+           {
+             push_slot_descriptors (damaged_command_buffer, slot);
+             vkCmdSetScissor (damaged_command_buffer, 0, 1, &scissors[slot]);
              vkCmdDrawIndirect (damaged_command_buffer, toplevel->indirect_draw_buffer
-                                , sizeof(typename ftk::ui::toplevel_window<Backend>::indirect_draw_info)*i, 1, 0);
-
+                                , indirect_draw_info_size*slot, 1, 0);
+           }
            vkCmdEndRenderPass(damaged_command_buffer);
+           write_timestamp (damaged_command_buffer, VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT);
 
-           vkCmdFillBuffer (damaged_command_buffer, toplevel->indirect_draw_buffer
-                            , sizeof(uint32_t) /* offset */, (5 + 4096) * sizeof(uint32_t), 0);
-
-           vkCmdFillBuffer (damaged_command_buffer, toplevel->indirect_draw_buffer
-                            , sizeof(uint32_t) * (6 + 4096) /* offset */, 4096 * sizeof(uint32_t), 0xFFFFFFFF);
+           for (std::size_t slot = 0; slot != scissors.size(); ++slot)
+             detail::render_thread_reset_indirect_slot
+               (damaged_command_buffer, toplevel->indirect_draw_buffer, indirect_draw_info_size*slot
+                , detail::render_thread_slot_entries (frame_scene.component_bounds
+                                                      , framebuffer_damaged_regions[slot]));
 
-           r = from_result (vkEndCommandBuffer(damaged_command_buffer));
-           if (r != vulkan_error_code::success)
-             throw std::system_error(make_error_code(r));
+           detail::render_thread_end_command_buffer (damaged_command_buffer);
+         }
+         else
+         {
+           // draw damage areas, each region writes its three
+           // timestamps at its own position so the regions may be
+           // recorded in any order
+           auto const record_region
+             = [&] (std::size_t i)
+               {
+                 auto&& region = framebuffer_damaged_regions[i];
+                 auto damaged_command_buffer = damaged_command_buffers[i];
+                 auto const write_region_timestamp
+                   = [&] (VkPipelineStageFlagBits stage, uint32_t pass)
+                     {
+                       uint32_t const query = 3 * i + pass;
+                       if (frame.timestamps != VK_NULL_HANDLE && query < frame.timestamp_capacity)
+                         vkCmdWriteTimestamp (damaged_command_buffer, stage, frame.timestamps, query);
+                     };
+
+                 VkRenderPassBeginInfo regionPassInfo = renderPassInfo;
+                 regionPassInfo.renderArea = detail::render_thread_render_area
+                   (region, toplevel->window.voutput.swapChainExtent);
+
+                 detail::render_thread_begin_command_buffer (damaged_command_buffer);
+                 if (i == 0)
+                   reset_timestamps (damaged_command_buffer);
+                 write_region_timestamp (VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT, 0);
+                 bind_descriptors (damaged_command_buffer);
+                 push_slot_descriptors (damaged_command_buffer, i);
+
+                 vkCmdBeginRenderPass(damaged_command_buffer, &regionPassInfo, VK_SUBPASS_CONTENTS_INLINE);
+                 vkCmdBindPipeline(damaged_command_buffer, VK_PIPELINE_BIND_POINT_GRAPHICS, indirect_pipeline.pipeline);
+                 VkRect2D scissor = regionPassInfo.renderArea;
+                 vkCmdSetScissor (damaged_command_buffer, 0, 1, &scissor);
+
+                 vkCmdDraw(damaged_command_buffer, 6, 1, 0, 0);
+
+                 VkMemoryBarrier memory_barrier = {VK_STRUCTURE_TYPE_MEMORY_BARRIER};
+                 memory_barrier.srcAccessMask = VK_ACCESS_SHADER_WRITE_BIT;
+                 memory_barrier.dstAccessMask = VK_ACCESS_SHADER_READ_BIT | VK_ACCESS_INDIRECT_COMMAND_READ_BIT;
+
+                 vkCmdPipelineBarrier (damaged_command_buffer, VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT
+                                       , VK_PIPELINE_STAGE_DRAW_INDIRECT_BIT
+                                       | VK_PIPELINE_STAGE_VERTEX_INPUT_BIT
+                                       | VK_PIPELINE_STAGE_VERTEX_SHADER_BIT
+                                       | VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT, VK_DEPENDENCY_DEVICE_GROUP_BIT
+                                       , 1, &memory_barrier, 0, /*&buffer_barrier*/nullptr, 0, nullptr);
+
+                 vkCmdEndRenderPass(damaged_command_buffer);
+                 write_region_timestamp (VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT, 1);
+                 vkCmdBeginRenderPass(damaged_command_buffer, &regionPassInfo, VK_SUBPASS_CONTENTS_INLINE);
+
+                 vkCmdBindPipeline(damaged_command_buffer, VK_PIPELINE_BIND_POINT_GRAPHICS, image_pipeline0.pipeline);
+                 vkCmdDrawIndirect (damaged_command_buffer, toplevel->indirect_draw_buffer
+                                    , indirect_draw_info_size*i, 1, 0);
+
+                 vkCmdEndRenderPass(damaged_command_buffer);
+                 write_region_timestamp (VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT, 2);
+
+                 detail::render_thread_reset_indirect_slot
+                   (damaged_command_buffer, toplevel->indirect_draw_buffer, indirect_draw_info_size*i
+                    , detail::render_thread_slot_entries (frame_scene.component_bounds, region));
+
+                 detail::render_thread_end_command_buffer (damaged_command_buffer);
+               };
+
+           // region i is recorded by worker i % recording_workers in a
+           // command buffer of that worker's pool, and writes timestamp
+           // queries 3*i to 3*i+2 only, so no two workers share a query.
+           // Region 0 resets the whole query range first, its command
+           // buffer is submitted before the others
+           if (recording_workers > 1)
+             detail::render_thread_record_parallel
+               (options.recording_executor, recording_workers
+                , [&] (std::size_t worker)
+                  {
+                    for (std::size_t i = worker; i < framebuffer_damaged_regions.size(); i += recording_workers)
+                      record_region (i);
+                  });
+           else
+             for (std::size_t i = 0; i != framebuffer_damaged_regions.size(); ++i)
+               record_region (i);
+
+           if (frame.timestamps != VK_NULL_HANDLE)
+             frame.timestamp_count = std::min<uint32_t>
+               (3 * framebuffer_damaged_regions.size(), frame.timestamp_capacity);
+         }
 
-           ++i;
+         // the frame read back is composed whole a second time, into
+         // the image of frame_readback, with indirect slot 0 once the
+         // regions reset it
+         if (read_back)
+         {
+           auto readback_command_buffer = damaged_command_buffers[damaged_command_buffer_count];
+           VkRenderPassBeginInfo readbackPassInfo = renderPassInfo;
+           readbackPassInfo.framebuffer = readback->framebuffer();
+           readbackPassInfo.renderArea = {{0, 0}, toplevel->window.voutput.swapChainExtent};
+
+           detail::render_thread_begin_command_buffer (readback_command_buffer);
+           readback->prepare (readback_command_buffer);
+           detail::render_thread_indirect_reset_barrier (readback_command_buffer);
+           bind_descriptors (readback_command_buffer);
+           push_slot_descriptors (readback_command_buffer, 0);
+
+           vkCmdBeginRenderPass(readback_command_buffer, &readbackPassInfo, VK_SUBPASS_CONTENTS_INLINE);
+           vkCmdBindPipeline(readback_command_buffer, VK_PIPELINE_BIND_POINT_GRAPHICS, indirect_pipeline.pipeline);
+           vkCmdSetScissor (readback_command_buffer, 0, 1, &readbackPassInfo.renderArea);
+           vkCmdDraw(readback_command_buffer, 6, 1, 0, 0);
+           vkCmdEndRenderPass(readback_command_buffer);
+
+           detail::render_thread_indirect_filled_barrier (readback_command_buffer);
+
+           vkCmdBeginRenderPass(readback_command_buffer, &readbackPassInfo, VK_SUBPASS_CONTENTS_INLINE);
+           vkCmdBindPipeline(readback_command_buffer, VK_PIPELINE_BIND_POINT_GRAPHICS, image_pipeline0.pipeline);
+           vkCmdSetScissor (readback_command_buffer, 0, 1, &readbackPassInfo.renderArea);
+           vkCmdDrawIndirect (readback_command_buffer, toplevel->indirect_draw_buffer, 0, 1, 0);
+           vkCmdEndRenderPass(readback_command_buffer);
+
+           detail::render_thread_reset_indirect_slot
+             (readback_command_buffer, toplevel->indirect_draw_buffer, 0
+              , detail::render_thread_slot_entries (frame_scene.component_bounds, extents));
+           readback->record (readback_command_buffer);
+           detail::render_thread_end_command_buffer (readback_command_buffer);
          }
          
          VkSubmitInfo submitInfo = {};
          submitInfo.sType = VK_STRUCTURE_TYPE_SUBMIT_INFO;
                              
-         std::vector<VkCommandBuffer> buffers = damaged_command_buffers;
 
          VkSemaphore waitSemaphores[] = {imageAvailable};
          VkPipelineStageFlags waitStages[] = {VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT};
          submitInfo.waitSemaphoreCount = 1;
          submitInfo.pWaitSemaphores = waitSemaphores;
          submitInfo.pWaitDstStageMask = waitStages;
-         submitInfo.commandBufferCount = buffers.size();
-         submitInfo.pCommandBuffers = &buffers[0];
+         submitInfo.commandBufferCount = damaged_command_buffer_count + read_back;
+         submitInfo.pCommandBuffers = damaged_command_buffers;
 
          VkSemaphore signalSemaphores[] = {renderFinished};
          submitInfo.signalSemaphoreCount = 1;
@@ -454,20 +1309,24 @@ std::thread render_thread (ftk::ui::toplevel_window<Backend>* toplevel, bool& di
 
            auto now = std::chrono::high_resolution_clock::now();
            auto diff = now - queue_begin;
-           std::cout << "Time locking queue "
+           frame.queue_wait = std::chrono::duration_cast<std::chrono::nanoseconds>(diff);
+           VWM_LOG (trace, render, "Time locking queue "
                      << std::chrono::duration_cast<std::chrono::milliseconds>(diff).count()
-                     << "ms" << std::endl;
+                     << "ms");
          
            //std::cout << "submit graphics " << buffers.size() << std::endl;
-           auto r = from_result(vkQueueSubmit(lock_queue.get_queue().vkqueue, 1, &submitInfo, executionFinished[imageIndex]));
+           auto r = from_result(vkQueueSubmit(lock_queue.get_queue().vkqueue, 1, &submitInfo, frame.execution_finished));
            if (r != vulkan_error_code::success)
              throw std::system_error(make_error_code (r));
+           frame.in_flight = true;
+           frame.recording = std::chrono::duration_cast<std::chrono::nanoseconds>
+             (frame_scheduler::clock::now() - frame.started);
 
            auto now2 = std::chrono::high_resolution_clock::now();
            auto diff2 = now2 - now;
-           std::cout << "Time submitting to queue "
+           VWM_LOG (trace, render, "Time submitting to queue "
                      << std::chrono::duration_cast<std::chrono::milliseconds>(diff2).count()
-                     << "ms" << std::endl;
+                     << "ms");
          }
 
          {
@@ -485,6 +1344,30 @@ std::thread render_thread (ftk::ui::toplevel_window<Backend>* toplevel, bool& di
            presentInfo.pImageIndices = &imageIndex;
            presentInfo.pResults = nullptr; // Optional
 
+           VkPresentRegionKHR present_region = {};
+           present_region.rectangleCount = present_rects.size();
+           present_region.pRectangles = present_rects.data();
+           VkPresentRegionsKHR present_regions = {};
+           present_regions.sType = VK_STRUCTURE_TYPE_PRESENT_REGIONS_KHR;
+           present_regions.swapchainCount = 1;
+           present_regions.pRegions = &present_region;
+           if (options.incremental_present)
+             presentInfo.pNext = &present_regions;
+
+           // an id makes the presentation engine report when the frame
+           // was actually shown
+           frame.present_id = ++present_id;
+           VkPresentTimeGOOGLE present_time = {frame.present_id, 0};
+           VkPresentTimesInfoGOOGLE present_times = {};
+           present_times.sType = VK_STRUCTURE_TYPE_PRESENT_TIMES_INFO_GOOGLE;
+           present_times.swapchainCount = 1;
+           present_times.pTimes = &present_time;
+           if (display_timing)
+           {
+             present_times.pNext = presentInfo.pNext;
+             presentInfo.pNext = &present_times;
+           }
+
            {
              ftk::ui::backend::vulkan_queues::lock_presentation_queue lock_queue(toplevel->window.queues);
          
@@ -499,9 +1382,9 @@ std::thread render_thread (ftk::ui::toplevel_window<Backend>* toplevel, bool& di
 
              auto now2 = std::chrono::high_resolution_clock::now();
              auto diff = now2 - now;
-             std::cout << "Time submitting presentation queue "
+             VWM_LOG (trace, render, "Time submitting presentation queue "
                        << std::chrono::duration_cast<std::chrono::milliseconds>(diff).count()
-                       << "ms" << std::endl;
+                       << "ms");
              // r = from_result(vkQueueWaitIdle (lock_queue.get_queue().vkqueue));
              // if (r != vulkan_error_code::success)
              //   throw std::system_error (make_error_code (r));
@@ -510,20 +1393,11 @@ std::thread render_thread (ftk::ui::toplevel_window<Backend>* toplevel, bool& di
            {
              auto now = std::chrono::high_resolution_clock::now();
              auto diff = now - queue_begin;
-             std::cout << "Time running drawing command "
+             VWM_LOG (trace, render, "Time running drawing command "
                        << std::chrono::duration_cast<std::chrono::milliseconds>(diff).count()
-                       << "ms" << std::endl;
+                       << "ms");
            }
 
-           if (vkWaitForFences (toplevel->window.voutput.device, 1, &executionFinished[imageIndex], VK_FALSE, -1) == VK_TIMEOUT)
-           {
-             //std::cout << "Timeout waiting for fence" << std::endl;
-             throw -1;
-           }
-           vkResetFences (toplevel->window.voutput.device, 1, &executionFinished[imageIndex]);
-           vkFreeCommandBuffers (toplevel->window.voutput.device, commandPool, damaged_command_buffers.size()
-                                 , &damaged_command_buffers[0]);
-
            /*
        {
            // indirect buffer
@@ -563,39 +1437,41 @@ std::thread render_thread (ftk::ui::toplevel_window<Backend>* toplevel, bool& di
            
          }
 
+         frame_index = (frame_index + 1) % frames.size();
+     }
+
+     {
+       // an image may still be acquired with a pending signal on its semaphore
+       ftk::ui::backend::vulkan_queues::lock_graphic_queue lock_queue(toplevel->window.queues);
+       vkQueueWaitIdle (lock_queue.get_queue().vkqueue);
      }
-     std::cout << "Exiting render thread" << std::endl;
+     while (auto frame = oldest_in_flight())
+       retire (*frame, false);
+     detail::render_thread_destroy_frame_contexts (toplevel->window.voutput.device, frames);
+     VWM_LOG (info, render, "Exiting render thread");
    });
   return thread;
 }
 
-inline std::function<void()> render_dirty (bool& dirty, std::mutex& mutex, std::condition_variable& cond)
-{
-  return [dirty = &dirty, mutex = &mutex, cond = &cond]
-         {
-           std::unique_lock<std::mutex> l(*mutex);
-           *dirty = true;
-           cond->notify_one();
-         };
-}
-
-inline std::function<void()> render_dirty (bool& dirty, std::unique_lock<std::mutex>& lock, std::condition_variable& cond)
+// pushes the toplevel changes as a new scene, called from the loop
+// thread after changing the toplevel, before releasing the scene_gate.
+// Returns the scene number, presented_frame::scene tells when it is
+// shown
+template <typename Toplevel>
+std::function<std::uint64_t()> render_dirty (Toplevel& toplevel, opaque_regions const* opaque_regions
+                                             , render_queue& queue)
 {
-  return [dirty = &dirty, &lock, cond = &cond]
+  return [toplevel = &toplevel, opaque_regions, queue = &queue]
          {
-           *dirty = true;
-           cond->notify_one();
-           lock.unlock();
+           return queue->push (make_scene (*toplevel, opaque_regions));
          };
 }
 
-inline std::function<void()> render_exit (bool& exit, std::mutex& mutex, std::condition_variable& cond)
+inline std::function<void()> render_exit (render_queue& queue)
 {
-  return [exit = &exit, mutex = &mutex, cond = &cond]
+  return [queue = &queue]
          {
-           std::unique_lock<std::mutex> l(*mutex);
-           *exit = true;
-           cond->notify_one();
+           queue->push (render_exit_request{});
          };
 }
   
@@ -0,0 +1,103 @@
+///////////////////////////////////////////////////////////////////////////////
+//
+// Copyright 2019 Felipe Magno de Almeida.
+// Distributed under the Boost Software License, Version 1.0. (See
+// accompanying file LICENSE_1_0.txt or copy at
+// http://www.boost.org/LICENSE_1_0.txt)
+// See http://www.boost.org/libs/foreach for documentation
+//
+
+#ifndef VWM_SCENE_HPP
+#define VWM_SCENE_HPP
+
+#include <vwm/region.hpp>
+#include <vwm/opaque_regions.hpp>
+#include <vwm/log.hpp>
+
+#include <vulkan/vulkan.h>
+
+#include <memory>
+#include <vector>
+#include <cstdint>
+
+namespace vwm {
+
+// What the render thread needs from the toplevel to record a frame,
+// built in the loop thread and never modified once pushed. The sets
+// and the buffer are the toplevel's own, they stay as the scene saw
+// them while a frame uses it through scene_gate
+struct scene
+{
+  // numbered by render_queue when pushed, from 1
+  std::uint64_t sequence = 0;
+  // damage since the previous scene
+  region damage;
+  std::uint32_t component_count = 0;
+  VkDescriptorSet texture_set = VK_NULL_HANDLE, sampler_set = VK_NULL_HANDLE;
+  VkBuffer component_ssbo = VK_NULL_HANDLE;
+  // of each component, in the order of the component buffer
+  std::vector<rect> component_bounds;
+};
+
+// Consumes the damage recorded in the toplevel. Components are walked
+// front to back, so what changed in a component is only damaged where
+// no opaque component above hides it. The damage the toplevel records
+// for moves and removals is kept whole
+template <typename Toplevel>
+std::unique_ptr<scene> make_scene (Toplevel& toplevel, opaque_regions const* opaque_regions)
+{
+  std::unique_ptr<scene> s (new scene);
+
+  for (auto&& regions : toplevel.framebuffers_damaged_regions)
+  {
+    for (auto&& damaged : regions)
+      s->damage.unite (rect{damaged.x, damaged.y, damaged.width, damaged.height});
+    regions.clear();
+  }
+
+  s->component_bounds.resize (toplevel.components.size());
+  auto component_bounds = s->component_bounds.rbegin();
+  region occluded;
+  for (auto it = toplevel.components.rbegin(); it != toplevel.components.rend(); ++it)
+  {
+    auto&& image = *it;
+    rect const bounds {image.x, image.y, image.width, image.height};
+    *component_bounds++ = bounds;
+    bool must_draw = false;
+    for (auto&& image_must_draw : image.must_draw)
+    {
+      must_draw = must_draw || image_must_draw;
+      image_must_draw = false;
+    }
+    if (must_draw && !occluded.contains (bounds))
+    {
+      VWM_LOG (trace, render, "found drawable image " << &image);
+      for (auto&& framebuffer_region : image.framebuffers_regions)
+        framebuffer_region = {image.x, image.y, image.width, image.height};
+      region visible (bounds);
+      visible.subtract (occluded);
+      s->damage.unite (visible);
+    }
+
+    if (opaque_regions)
+      if (auto opaque = opaque_regions->find (&image))
+      {
+        region covered (*opaque);
+        covered.translate (image.x, image.y);
+        covered.intersect (bounds);
+        occluded.unite (covered);
+      }
+  }
+
+  s->damage.intersect (rect{0, 0, static_cast<std::int32_t>(toplevel.window.voutput.swapChainExtent.width)
+                            , static_cast<std::int32_t>(toplevel.window.voutput.swapChainExtent.height)});
+  s->component_count = toplevel.components.size();
+  s->texture_set = toplevel.texture_descriptors.set;
+  s->sampler_set = toplevel.sampler_descriptors.set;
+  s->component_ssbo = toplevel.component_ssbo_buffer;
+  return s;
+}
+
+}
+
+#endif
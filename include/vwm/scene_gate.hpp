@@ -0,0 +1,167 @@
+///////////////////////////////////////////////////////////////////////////////
+//
+// Copyright 2019 Felipe Magno de Almeida.
+// Distributed under the Boost Software License, Version 1.0. (See
+// accompanying file LICENSE_1_0.txt or copy at
+// http://www.boost.org/LICENSE_1_0.txt)
+// See http://www.boost.org/libs/foreach for documentation
+//
+
+#ifndef VWM_SCENE_GATE_HPP
+#define VWM_SCENE_GATE_HPP
+
+#include <condition_variable>
+#include <functional>
+#include <list>
+#include <mutex>
+#include <utility>
+#include <cstddef>
+
+namespace vwm {
+
+// A scene points to toplevel resources, the component buffer and the
+// descriptor sets, that the loop thread changes in place. The render
+// thread holds the gate for every frame from taking its scene until
+// the frame's fence signals. The loop thread never waits for those
+// frames: a change that finds the gate held is queued, no new frame
+// starts, and once the last frame in use retires the render thread
+// calls wake, which must make the loop thread call dispatch to run
+// the queued changes. The render thread only waits for the loop
+// thread while it changes the toplevel, which takes no GPU work
+struct scene_gate
+{
+  typedef std::list<std::function<void()>>::iterator connection;
+
+  // wake is called from the render thread or the loop thread
+  explicit scene_gate (std::function<void()> wake)
+    : wake (std::move (wake)) {}
+  scene_gate (scene_gate const&) = delete;
+  scene_gate& operator= (scene_gate const&) = delete;
+
+  // loop thread, a Lockable for std::unique_lock with std::adopt_lock.
+  // Fails while frames use the scene or changes are queued, dispatch
+  // is then called once they retire
+  bool try_lock ()
+  {
+    bool idle;
+    {
+      std::unique_lock<std::mutex> l (mutex);
+      if (!frames && !changing && !closed && queued.empty())
+      {
+        changing = true;
+        return true;
+      }
+      waiting = !closed;
+      idle = !frames;
+    }
+    if (idle)
+      wake ();
+    return false;
+  }
+  void unlock ()
+  {
+    {
+      std::unique_lock<std::mutex> l (mutex);
+      changing = false;
+    }
+    changed.notify_all();
+  }
+
+  // loop thread, runs change now if the gate is free, otherwise in
+  // dispatch, after the changes queued before it. It must not hold
+  // anything that may go away before then
+  void change (std::function<void()> change)
+  {
+    if (try_lock ())
+    {
+      std::unique_lock<scene_gate> locked (*this, std::adopt_lock);
+      change ();
+    }
+    else
+      queued.push_back (std::move (change));
+  }
+
+  // loop thread, retry is called in every dispatch with the gate
+  // locked, for changes kept by an owner that may go away first
+  connection connect (std::function<void()> retry)
+  {
+    return retries.insert (retries.end(), std::move (retry));
+  }
+  void disconnect (connection c)
+  {
+    retries.erase (c);
+  }
+
+  // loop thread, after wake
+  void dispatch ()
+  {
+    {
+      std::unique_lock<std::mutex> l (mutex);
+      // the last frame to retire wakes again
+      if (frames || changing || closed)
+        return;
+      changing = true;
+      waiting = false;
+    }
+    std::unique_lock<scene_gate> locked (*this, std::adopt_lock);
+    while (!queued.empty())
+    {
+      auto change = std::move (queued.front());
+      queued.pop_front();
+      change ();
+    }
+    for (auto&& retry : retries)
+      retry ();
+  }
+
+  // loop thread, before stopping the render thread. Queued changes
+  // are dropped and frames no longer wait for dispatch
+  void close ()
+  {
+    {
+      std::unique_lock<std::mutex> l (mutex);
+      closed = true;
+      waiting = false;
+    }
+    changed.notify_all();
+    queued.clear();
+  }
+
+  // render thread, before taking the scene of a frame. False when
+  // changes wait for frames still in use, the render thread must
+  // retire one of them before trying again
+  bool try_use ()
+  {
+    std::unique_lock<std::mutex> l (mutex);
+    if (waiting && frames)
+      return false;
+    changed.wait (l, [this] { return !changing && !waiting; });
+    ++frames;
+    return true;
+  }
+
+  // render thread, once the frame's fence signaled
+  void release ()
+  {
+    bool idle;
+    {
+      std::unique_lock<std::mutex> l (mutex);
+      idle = !--frames && waiting;
+    }
+    if (idle)
+      wake ();
+  }
+
+private:
+  std::mutex mutex;
+  std::condition_variable changed;
+  std::size_t frames = 0;
+  bool waiting = false, changing = false, closed = false;
+  std::function<void()> wake;
+  // loop thread only
+  std::list<std::function<void()>> queued, retries;
+};
+
+}
+
+#endif
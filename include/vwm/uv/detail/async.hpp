@@ -0,0 +1,71 @@
+///////////////////////////////////////////////////////////////////////////////
+//
+// Copyright 2019 Felipe Magno de Almeida.
+// Distributed under the Boost Software License, Version 1.0. (See
+// accompanying file LICENSE_1_0.txt or copy at
+// http://www.boost.org/LICENSE_1_0.txt)
+// See http://www.boost.org/libs/foreach for documentation
+//
+
+#ifndef VWM_VWM_UV_DETAIL_ASYNC_HPP
+#define VWM_VWM_UV_DETAIL_ASYNC_HPP
+
+#include <uv.h>
+
+#include <functional>
+#include <mutex>
+#include <utility>
+
+namespace vwm { namespace ui { namespace detail {
+
+// Runs a function in the loop thread when any thread notifies it.
+// Other threads may hold it past close, through a shared_ptr, and
+// their notifications are then dropped
+struct async_notifier
+{
+  async_notifier (uv_loop_t* loop, std::function<void()> function)
+    : handle (new uv_async_t)
+  {
+    ::uv_async_init (loop, handle, [] (uv_async_t* handle)
+                                   {
+                                     (*static_cast<std::function<void()>*>(handle->data))();
+                                   });
+    handle->data = new std::function<void()>(std::move (function));
+    // pending notifications alone do not keep the loop running
+    ::uv_unref (reinterpret_cast<uv_handle_t*>(handle));
+  }
+
+  async_notifier (async_notifier const&) = delete;
+  async_notifier& operator= (async_notifier const&) = delete;
+
+  // any thread
+  void notify ()
+  {
+    std::unique_lock<std::mutex> l (mutex);
+    if (handle)
+      ::uv_async_send (handle);
+  }
+
+  // loop thread, before the owner of the function goes away
+  void close ()
+  {
+    std::unique_lock<std::mutex> l (mutex);
+    if (!handle)
+      return;
+    ::uv_close (reinterpret_cast<uv_handle_t*>(handle)
+                , [] (uv_handle_t* handle)
+                  {
+                    delete static_cast<std::function<void()>*>(handle->data);
+                    delete reinterpret_cast<uv_async_t*>(handle);
+                  });
+    handle = nullptr;
+  }
+
+private:
+  std::mutex mutex;
+  uv_async_t* handle;
+};
+
+} } }
+
+#endif
@@ -8,6 +8,7 @@
 //
 
 #include <vwm/uv/detail/poll.hpp>
+#include <vwm/log.hpp>
 
 #include <sys/stat.h>
 #include <fcntl.h>
@@ -20,7 +21,6 @@
 #include <xkbcommon/xkbcommon.h>
 
 #include <cassert>
-#include <iostream>
 #include <cstring>
 #include <functional>
 
@@ -76,30 +76,30 @@ vwm::keyboard init ( ::uv_loop_t* loop, std::function<void(uint32_t, uint32_t, u
     [li, state, function, keyboard] (uv_poll_t*)
     {
       struct libinput_event *event;
-      std::cout << "event on fd" << std::endl;
+      VWM_LOG (trace, input, "event on fd");
       libinput_dispatch(li);
       while ((event = libinput_get_event(li)) != NULL)
       {
         // handle the event here
-        std::cout << "event is not null" << std::endl;
+        VWM_LOG (trace, input, "event is not null");
 
         auto t = libinput_event_get_type (event);
         switch (t)
         {
         case LIBINPUT_EVENT_POINTER_MOTION_ABSOLUTE:
-          std::cout << "LIBINPUT_EVENT_POINTER_MOTION_ABSOLUTE" << std::endl;
+          VWM_LOG (debug, input, "LIBINPUT_EVENT_POINTER_MOTION_ABSOLUTE");
           break;
         case LIBINPUT_EVENT_POINTER_MOTION:
-          std::cout << "LIBINPUT_EVENT_POINTER_MOTION" << std::endl;
+          VWM_LOG (debug, input, "LIBINPUT_EVENT_POINTER_MOTION");
           break;
         case LIBINPUT_EVENT_POINTER_BUTTON:
-          std::cout << "LIBINPUT_EVENT_POINTER_BUTTON" << std::endl;
+          VWM_LOG (debug, input, "LIBINPUT_EVENT_POINTER_BUTTON");
           break;
         case LIBINPUT_EVENT_TOUCH_DOWN:
-          std::cout << "LIBINPUT_EVENT_TOUCH_DOWN" << std::endl;
+          VWM_LOG (debug, input, "LIBINPUT_EVENT_TOUCH_DOWN");
           break;
         case LIBINPUT_EVENT_DEVICE_ADDED:{
-          std::cout << "LIBINPUT_EVENT_DEVICE_ADDED" << std::endl;
+          VWM_LOG (debug, input, "LIBINPUT_EVENT_DEVICE_ADDED");
 
           libinput_event_device_notify* ev = libinput_event_get_device_notify_event (event);
 
@@ -109,40 +109,40 @@ vwm::keyboard init ( ::uv_loop_t* loop, std::function<void(uint32_t, uint32_t, u
           
           if (libinput_device_has_capability (dev, LIBINPUT_DEVICE_CAP_KEYBOARD))
           {
-            std::cout << "a keyboard" << std::endl;
+            VWM_LOG (debug, input, "a keyboard");
           }
           if (libinput_device_has_capability (dev, LIBINPUT_DEVICE_CAP_POINTER))
           {
-            std::cout << "a mouse" << std::endl;
+            VWM_LOG (debug, input, "a mouse");
           }
           if (libinput_device_has_capability (dev, LIBINPUT_DEVICE_CAP_TOUCH))
           {
-            std::cout << "a touchscreen" << std::endl;
+            VWM_LOG (debug, input, "a touchscreen");
           }
           if (libinput_device_has_capability (dev, LIBINPUT_DEVICE_CAP_GESTURE))
           {
-            std::cout << "a gesture input" << std::endl;
+            VWM_LOG (debug, input, "a gesture input");
           }
           if (libinput_device_has_capability (dev, LIBINPUT_DEVICE_CAP_SWITCH))
           {
-            std::cout << "a switch input" << std::endl;
+            VWM_LOG (debug, input, "a switch input");
           }
           if (libinput_device_has_capability (dev, LIBINPUT_DEVICE_CAP_TABLET_TOOL))
           {
-            std::cout << "a tablet tool " << libinput_device_get_name (dev) << std::endl;
+            VWM_LOG (debug, input, "a tablet tool " << libinput_device_get_name (dev));
           }
           if (libinput_device_has_capability (dev, LIBINPUT_DEVICE_CAP_TABLET_PAD))
           {
-            std::cout << "a tablet pad " << libinput_device_get_name (dev) << std::endl;
+            VWM_LOG (debug, input, "a tablet pad " << libinput_device_get_name (dev));
           }
           
           break;}
         case LIBINPUT_EVENT_KEYBOARD_KEY:
-          std::cout << "LIBINPUT_EVENT_KEYBOARD_KEY" << std::endl;
+          VWM_LOG (debug, input, "LIBINPUT_EVENT_KEYBOARD_KEY");
           {
             libinput_event_keyboard* ev = libinput_event_get_keyboard_event (event);
-            std::cout << "key " << libinput_event_keyboard_get_key (ev) + 8
-                      << " key state " << (int)libinput_event_keyboard_get_key_state (ev) << std::endl;
+            VWM_LOG (debug, input, "key " << libinput_event_keyboard_get_key (ev) + 8
+                      << " key state " << (int)libinput_event_keyboard_get_key_state (ev));
 
             auto code = libinput_event_keyboard_get_key (ev) + 8;
 
@@ -153,7 +153,7 @@ vwm::keyboard init ( ::uv_loop_t* loop, std::function<void(uint32_t, uint32_t, u
             const xkb_keysym_t* syms;
             auto sym_size = xkb_state_key_get_syms (state, code, &syms);
 
-            std::cout << "keysyms " << sym_size << std::endl;
+            VWM_LOG (debug, input, "keysyms " << sym_size);
 
             if (sym_size)
             {
@@ -163,13 +163,13 @@ vwm::keyboard init ( ::uv_loop_t* loop, std::function<void(uint32_t, uint32_t, u
               std::memset(key, 0, sizeof(key));
               xkb_keysym_get_name(sym, key, sizeof(key));
 
-              std::cout << "key is " << key << std::endl;
+              VWM_LOG (debug, input, "key is " << key);
 
               char utf8[64];
               std::memset(utf8, 0, sizeof(utf8));
               xkb_keysym_to_utf8(sym, utf8, sizeof(utf8));
 
-              std::cout << "utf8 " << utf8 << std::endl;
+              VWM_LOG (debug, input, "utf8 " << utf8);
 
               // do something with it
               if (function)
@@ -181,14 +181,14 @@ vwm::keyboard init ( ::uv_loop_t* loop, std::function<void(uint32_t, uint32_t, u
           }
           break;
         default:
-          std::cout << "number is " << (int)t << std::endl;
+          VWM_LOG (debug, input, "number is " << (int)t);
         };
         
     
         libinput_event_destroy(event);
         libinput_dispatch(li);
       }
-      std::cout << "event is null" << std::endl;
+      VWM_LOG (warning, input, "event is null");
     };
 
   vwm::ui::detail::wait (loop, fd, UV_READABLE, lambda);
@@ -22,7 +22,15 @@
 //#include <xf86drmMode.h>
 
 #include <cassert>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
 #include <iostream>
+#include <memory>
+#include <optional>
+#include <string>
+#include <type_traits>
 #include <string.h>
 
 #include <fastdraw/output/vulkan/add_image.hpp>
@@ -45,6 +53,7 @@
 //#include <vwm/backend/libinput.hpp>
 #include <vwm/backend/xlib_keyboard.hpp>
 #include <vwm/backend/xlib_mouse.hpp>
+#include <vwm/uv/detail/async.hpp>
 #include <vwm/uv/detail/poll.hpp>
 #include <vwm/uv/detail/timer.hpp>
 #include <vwm/theme.hpp>
@@ -52,6 +61,13 @@
 #include <vwm/wayland/client.hpp>
 #include <ftk/ui/backend/vulkan_draw.hpp>
 #include <vwm/render_thread.hpp>
+#include <vwm/presentation_feedback.hpp>
+#include <vwm/opaque_regions.hpp>
+#include <vwm/scene_gate.hpp>
+#include <vwm/cursor_layer.hpp>
+#include <vwm/backend/headless_surface.hpp>
+#include <vwm/render_metrics.hpp>
+#include <vwm/log.hpp>
 #include <portable_concurrency/thread_pool>
 
 // #include <wayland-server-core.h>
@@ -63,22 +79,93 @@
 
 int drm_init();
 
-int main(void) {
+struct run_options
+{
+  std::uint32_t width = 1280, height = 1000;
+  // headless only, the refresh the uv timer ticks at and how many
+  // ticks before exiting, 0 runs until the loop stops
+  std::chrono::nanoseconds refresh {16666667};
+  std::uint64_t frames = 0;
+  std::uint64_t readback_frame = 0;
+  std::filesystem::path readback_path;
+  // all damaged regions scissored in one render pass pair, needs a
+  // render pass loading the attachment
+  bool single_pass = false;
+};
+
+template <typename WindowingBase>
+int run (run_options const& options) {
+  bool const constexpr is_xlib = std::is_same<WindowingBase, ftk::ui::backend::xlib_surface<ftk::ui::backend::uv>>::value;
   try {
+  auto const start = std::chrono::steady_clock::now();
   ::uv_loop_t loop;
-  bool dirty = false, exit = false;;
-  std::mutex render_mutex;
-  std::condition_variable condvar;
   std::int32_t surface_start_x = 0, surface_start_y = 0;
   std::int32_t surface_start_x_offset = 30, surface_start_y_offset = 30;
 
   uv_loop_init (&loop);
+  // listening before the device and theme are ready, clients that
+  // connect during startup wait in the backlog instead of failing
+  int socket = -1;
+  {
+    auto runtime_dir = getenv("XDG_RUNTIME_DIR");
+
+    const char* name = "wayland-0";
+    struct sockaddr_un addr;
+    addr.sun_family = AF_LOCAL;
+    auto name_size = snprintf(addr.sun_path, sizeof(addr.sun_path),
+                              "%s/%s", runtime_dir, name) + 1;
+    socket = ::socket(PF_LOCAL, SOCK_STREAM | SOCK_CLOEXEC, 0);
+    assert (socket > 0);
+
+    auto br = bind (socket, static_cast<sockaddr*>(static_cast<void*>(&addr)), sizeof (addr.sun_family) + name_size);
+    if (br != 0)
+    {
+      perror ("error: ");
+      return -1;
+    }
+
+    auto lr = listen (socket, 128);
+    if (lr != 0)
+    {
+      perror ("error: ");
+      return -1;
+    }
+
+    // char socket[512];
+    // sprintf (socket, "%d", fd);
+    //std::cout << "socket: " << socket << std::endl;
+    setenv("WAYLAND_DISPLAY", /*socket*/"wayland-0", 1);
+  }
+
+  vwm::presentation_feedback presentation_feedback (&loop);
+  vwm::opaque_regions opaque_regions;
+  vwm::render_queue render_queue;
+  // toplevel changes that found frames using the scene run once the
+  // render thread retired them
+  std::shared_ptr<vwm::ui::detail::async_notifier> scene_gate_open;
+  vwm::scene_gate scene_gate ([&scene_gate_open] { scene_gate_open->notify(); });
+  scene_gate_open = std::make_shared<vwm::ui::detail::async_notifier>
+    (&loop, [&scene_gate, &loop]
+     {
+       try
+       {
+         scene_gate.dispatch();
+       }
+       catch (std::exception const& e)
+       {
+         VWM_LOG (error, main, "Error changing the scene: " << e.what());
+         uv_stop (&loop);
+       }
+     });
   namespace pc = portable_concurrency;
   pc::static_thread_pool thread_pool {8};
+  // frames wait for their recording, it is not queued behind uploads
+  // and theme decoding
+  pc::static_thread_pool recording_pool {3};
   typedef pc::static_thread_pool::executor_type executor_type;
 
-  typedef ftk::ui::backend::vulkan<ftk::ui::backend::uv, ftk::ui::backend::xlib_surface<ftk::ui::backend::uv>> backend_type;
-  typedef vwm::wayland::client<vwm::backend::xlib::keyboard, executor_type, ftk::ui::backend::xlib_surface<ftk::ui::backend::uv>> client_type;
+  typedef ftk::ui::backend::vulkan<ftk::ui::backend::uv, WindowingBase> backend_type;
+  typedef vwm::wayland::client<vwm::backend::xlib::keyboard, executor_type, WindowingBase> client_type;
   
   vwm::wayland::generated::server_protocol<client_type>* focused = nullptr;
 
@@ -86,112 +173,178 @@ int main(void) {
 
   backend_type backend({&loop});
   std::filesystem::path res_path = "deps/ftk/compiled-res";
-  auto vulkan_window = backend.create_window (1280, 1000, res_path); 
+  auto vulkan_window = backend.create_window (options.width, options.height, res_path); 
   ftk::ui::backend::vulkan_submission_pool<executor_type>
     vulkan_submission_pool (vulkan_window.voutput.device
                             , &vulkan_window.queues
                             , thread_pool.executor()
                             , 4 /* thread count */);
   
-  auto empty_image = ftk::ui::backend::load_empty_image_view
-    (vulkan_window.voutput.device, vulkan_window.voutput.physical_device
-     , vulkan_submission_pool).get();
-  ftk::ui::toplevel_window<backend_type&> w(vulkan_window, res_path, empty_image.image_view);
-  
+  // the theme only needs the device, its images decode in the thread
+  // pool while the toplevel and the render thread are set up
   vwm::theme<fastdraw::image_loader::extension_loader
              , ftk::ui::backend::vulkan_image_loader<executor_type>>
     theme {{},
-           {w.window.voutput.device, w.window.voutput.physical_device
+           {vulkan_window.voutput.device, vulkan_window.voutput.physical_device
             , &vulkan_submission_pool}
            , std::filesystem::current_path()};
 
-  // pc::future<ftk::ui::backend::vulkan_image> mouse_cursor = theme[vwm::theme_image::pointer];
-  // pc::future<ftk::ui::backend::vulkan_image> background = theme[vwm::theme_image::pointer];
-  pc::future<ftk::ui::backend::vulkan_image> mouse_cursor = theme[vwm::theme_image::pointer];
-  pc::future<ftk::ui::backend::vulkan_image> background = theme[vwm::theme_image::background];
-
-  auto background_img = background.get();
-
-  w.append_component ({0, 0
-                       , static_cast<int32_t>(w.window.voutput.swapChainExtent.width)
-                       , static_cast<int32_t>(w.window.voutput.swapChainExtent.height)
-                       , ftk::ui::image_component{background_img.image_view}});
+  pc::shared_future<ftk::ui::backend::vulkan_image> mouse_cursor = theme[vwm::theme_image::pointer].share();
+  pc::shared_future<ftk::ui::backend::vulkan_image> background = theme[vwm::theme_image::background].share();
 
-  // w.framebuffers_damaged_regions[0].push_back
-  //   ({0, 0, static_cast<int32_t>(w.window.voutput.swapChainExtent.width)
-  //     , static_cast<int32_t>(w.window.voutput.swapChainExtent.height)});
-  // w.framebuffers_damaged_regions[1].push_back
-  //   ({0, 0, static_cast<int32_t>(w.window.voutput.swapChainExtent.width)
-  //     , static_cast<int32_t>(w.window.voutput.swapChainExtent.height)});
-  w.append_component ({100, 100, 160, 90, ftk::ui::image_component{background_img.image_view}});
-  vwm::render_dirty (dirty, render_mutex, condvar)();
+  // the toplevel needs a view for its unused descriptors, a one pixel
+  // image that is ready long before the theme
+  auto empty_image = ftk::ui::backend::load_empty_image_view
+    (vulkan_window.voutput.device, vulkan_window.voutput.physical_device
+     , vulkan_submission_pool).get();
+  ftk::ui::toplevel_window<backend_type&> w(vulkan_window, res_path, empty_image.image_view);
 
-  bool is_moving_window = false;
-  
-  backend.key_signal.connect
-    ([&focused, &keyboard, &is_moving_window] (// std::uint32_t time, std::uint32_t key, std::uint32_t state
-                 XKeyEvent ev)
+  // started before waiting for the theme, the render thread compiles
+  // its pipelines and fills the indirect buffer meanwhile
+  vwm::render_options render_options;
+  render_options.feedback = &presentation_feedback;
+  render_options.gate = &scene_gate;
+  // the headless surface has no display to time, its refresh is given
+  if constexpr (is_xlib)
+    render_options.display_timing = vwm::detail::render_thread_has_device_extension
+      (w.window.voutput.physical_device, VK_GOOGLE_DISPLAY_TIMING_EXTENSION_NAME);
+  else
+    render_options.scheduling.refresh = options.refresh;
+  render_options.readback_frame = options.readback_frame;
+  render_options.readback_path = options.readback_path;
+  if (options.readback_frame)
+    vwm::frame_readback::check_format (w.window.voutput.swapChainImageFormat);
+  vwm::render_metrics render_metrics;
+  render_options.metrics = &render_metrics;
+  if (options.single_pass)
+    render_options.mode = vwm::render_mode::single_pass;
+  render_options.recording_executor = [executor = recording_pool.executor()] (std::function<void()> f)
+                                      {
+                                        post (executor, std::move (f));
+                                      };
+  auto thread = vwm::render_thread (&w, render_queue, render_options);
+  // stops the render thread on every way out of run
+  struct render_thread_stop
+  {
+    void operator() ()
+    {
+      if (thread.joinable())
+      {
+        // frames no longer wait for the loop thread
+        gate.close();
+        vwm::render_exit (queue)();
+        thread.join();
+      }
+    }
+    ~render_thread_stop () { (*this)(); }
+    vwm::render_queue& queue;
+    vwm::scene_gate& gate;
+    std::thread& thread;
+  } stop_render_thread {render_queue, scene_gate, thread};
+
+  // startup time up to the first presented frame, and up to the first
+  // presented frame with a client's surface
+  std::uint64_t first_client_scene = 0;
+  std::chrono::nanoseconds time_to_first_frame {0}, time_to_first_client_frame {0};
+  presentation_feedback.connect
+    ([start, &first_client_scene, &time_to_first_frame, &time_to_first_client_frame]
+     (vwm::presented_frame const& frame)
      {
-       std::cout << "key signal focused: "  << focused << std::endl;
-       if (is_moving_window && ev.keycode == XKB_KEY_Shift_L && ev.type == KeyRelease)
+       if (time_to_first_frame.count() == 0)
        {
-         is_moving_window = false;
+         time_to_first_frame = std::chrono::steady_clock::now() - start;
+         VWM_LOG (info, main, "first frame presented after "
+                  << std::chrono::duration_cast<std::chrono::milliseconds>(time_to_first_frame).count() << "ms");
        }
-       
-       if (focused)
+       if (first_client_scene && time_to_first_client_frame.count() == 0
+           && frame.scene >= first_client_scene)
        {
-         std::cout << " sending key "  << ev.keycode << "  type " << ev.type << std::endl;
-         keyboard.update_state (ev.keycode, ev.type == KeyPress);
-         focused->send_key(ev.time, ev.keycode - 8, ev.type == KeyPress ? 1 : 0);
+         time_to_first_client_frame = std::chrono::steady_clock::now() - start;
+         VWM_LOG (info, main, "first client frame presented after "
+                  << std::chrono::duration_cast<std::chrono::milliseconds>(time_to_first_client_frame).count() << "ms");
        }
      });
 
-  auto mouse_iterator = w.components.end();
+  auto const render_dirty = vwm::render_dirty (w, &opaque_regions, render_queue);
+  // created once the pointer image decodes, moves before are dropped
+  std::optional<vwm::cursor_layer<decltype(w)>> cursor;
+  // surfaces mapped by clients go below the cursor
+  std::function<std::uint64_t()> const client_render_dirty = [&cursor, render_dirty, &first_client_scene]
+                                                             {
+                                                               if (cursor)
+                                                                 cursor->keep_on_top();
+                                                               auto const scene = render_dirty();
+                                                               if (!first_client_scene)
+                                                                 first_client_scene = scene;
+                                                               return scene;
+                                                             };
 
-#if 1
+  bool is_moving_window = false;
   vwm::backend::xlib::mouse mouse;
-  backend.button_signal.connect
-    ([&mouse, &keyboard, &is_moving_window] (XButtonEvent ev)
-     {
-       if (xkb_state_mod_indices_are_active (keyboard.state, XKB_STATE_MODS_EFFECTIVE, XKB_STATE_MATCH_ALL
-                                             , XKB_KEY_Shift_L, XKB_MOD_INVALID))
-       {
-         std::cout << "Shift is pressed" << std::endl;
-         is_moving_window = true;
-       }
-     });
-     
-  backend.motion_signal.connect
-    ([&mouse, &mouse_iterator, &w, &mouse_cursor, &dirty, &render_mutex, &condvar
-      , &keyboard, &is_moving_window] (XMotionEvent ev)
-     {
-       static auto mouse_cursor_ = mouse_cursor.get();
 
-       if (is_moving_window)
+  if constexpr (is_xlib)
+  {
+    backend.key_signal.connect
+      ([&focused, &keyboard, &is_moving_window] (// std::uint32_t time, std::uint32_t key, std::uint32_t state
+                   XKeyEvent ev)
        {
-         // which window ?
-       }
+         VWM_LOG (debug, main, "key signal focused: "  << focused);
+         if (is_moving_window && ev.keycode == XKB_KEY_Shift_L && ev.type == KeyRelease)
+         {
+           is_moving_window = false;
+         }
+       
+         if (focused)
+         {
+           VWM_LOG (debug, main, " sending key "  << ev.keycode << "  type " << ev.type);
+           keyboard.update_state (ev.keycode, ev.type == KeyPress);
+           focused->send_key(ev.time, ev.keycode - 8, ev.type == KeyPress ? 1 : 0);
+         }
+       });
 
-       std::unique_lock<std::mutex> l (render_mutex);
-       if (mouse_iterator == w.components.end())
+    backend.button_signal.connect
+      ([&mouse, &keyboard, &is_moving_window] (XButtonEvent ev)
        {
-         std::cout << "mouse adding new mouse image" << std::endl;
-         mouse_iterator = w.append_component ({ev.x, ev.y, 32, 32, ftk::ui::image_component{mouse_cursor_.image_view}});
-         //vwm::render_dirty (dirty, mutex, condvar)();
-       }
-       else
+         if (xkb_state_mod_indices_are_active (keyboard.state, XKB_STATE_MODS_EFFECTIVE, XKB_STATE_MATCH_ALL
+                                               , XKB_KEY_Shift_L, XKB_MOD_INVALID))
+         {
+           VWM_LOG (debug, main, "Shift is pressed");
+           is_moving_window = true;
+         }
+       });
+     
+    backend.motion_signal.connect
+      ([&mouse, &cursor, &keyboard, &is_moving_window] (XMotionEvent ev)
        {
-         std::cout << "replacing coordinates" << std::endl;
-         //*mouse_iterator = {mouse_cursor_.image_view, ev.x, ev.y, 32, 32};
-         // change vertex buffer ?
-         // mouse_iterator->x = ev.x;
-         // mouse_iterator->y = ev.y;
-         w.move_component (mouse_iterator, ev.x, ev.y);
-       }
-       std::cout << "please render mouse (" << w.components.size() << ") at " << ev.x << "x" << ev.y << std::endl;
-       vwm::render_dirty (dirty, l, condvar)();
-     });
-#endif
+         if (is_moving_window)
+         {
+           // which window ?
+         }
+
+         if (cursor)
+           cursor->move (ev.time, ev.x, ev.y);
+       });
+  }
+  else
+  {
+    // sweeps the cursor across the output, so every tick composes a
+    // frame with a little damage
+    backend.start_ticks
+      (options.refresh
+       , [&cursor, &options, loop = &loop] (std::uint64_t tick, uv_timer_t* timer)
+         {
+           std::int32_t const width = options.width - 32, height = options.height - 32;
+           if (cursor)
+             cursor->move (tick * std::chrono::duration_cast<std::chrono::milliseconds>(options.refresh).count()
+                           , tick * 7 % width, tick * 5 % height);
+           if (options.frames && tick == options.frames)
+           {
+             uv_timer_stop (timer);
+             uv_stop (loop);
+           }
+         });
+  }
+
 #if 0
   unsigned int timer_iteration = 0;
   int32_t positions[][2] =
@@ -215,7 +368,6 @@ int main(void) {
      , [&] (uv_timer_t* timer)
        {
          static auto mouse_cursor_ = mouse_cursor.get();
-         std::unique_lock<std::mutex> l (render_mutex);
          if (mouse_iterator == w.images.end())
          {
            std::cout << "mouse adding new mouse image" << std::endl;
@@ -245,49 +397,27 @@ int main(void) {
            //   w.append_image ({background_img.image_view, 500, 100, 160, 90});
            // }
            // uv_timer_set_repeat (timer, 1000);
-           // vwm::render_dirty (dirty, l, condvar)();
+           // render_dirty();
            timer_iteration = 0;
            return;
          }
          //std::cout << "please render mouse (" << w.images.size() << ") at " << ev.x << "x" << ev.y << std::endl;
          timer_iteration++;
-         vwm::render_dirty (dirty, l, condvar)();
+         render_dirty();
        });
 #endif  
   
+  // clients are accepted once the background is below their surfaces,
+  // until then they wait in the listen backlog
+  auto const accept_clients = [&]
   {
-    ////////////////////////////////////////////
-    auto runtime_dir = getenv("XDG_RUNTIME_DIR");
-
-    const char* name = "wayland-0";
-    struct sockaddr_un addr;
-    addr.sun_family = AF_LOCAL;
-    auto name_size = snprintf(addr.sun_path, sizeof(addr.sun_path),
-                              "%s/%s", runtime_dir, name) + 1;
-    auto socket = ::socket(PF_LOCAL, SOCK_STREAM | SOCK_CLOEXEC, 0);
-    assert (socket > 0);
-
-    auto br = bind (socket, static_cast<sockaddr*>(static_cast<void*>(&addr)), sizeof (addr.sun_family) + name_size);
-    if (br != 0)
-    {
-      perror ("error: ");
-      return -1;
-    }
-
-    auto lr = listen (socket, 128);
-    if (lr != 0)
-    {
-      perror ("error: ");
-      return -1;
-    }
-
     vwm::ui::detail::wait (&loop, socket, UV_READABLE
                            , [loop = &loop, socket, backend = &backend, toplevel = &w, keyboard = &keyboard, &focused
-                              , &dirty, &render_mutex, render_condvar = &condvar
+                              , &client_render_dirty, &presentation_feedback, &opaque_regions, &scene_gate
                               , &theme, &surface_start_x, &surface_start_y
                               , surface_start_x_offset, surface_start_y_offset] (uv_poll_t* handle, int event)
                              {
-                               std::cout << "can be accepted?" << std::endl;
+                               VWM_LOG (debug, main, "can be accepted?");
 
                                struct sockaddr_un name;
                                int fd;
@@ -300,13 +430,13 @@ int main(void) {
 
                                vwm::wayland::generated::server_protocol<client_type>*
                                  c = new vwm::wayland::generated::server_protocol<client_type>
-                                 {new_socket, loop, backend, toplevel, keyboard, vwm::render_dirty (dirty, render_mutex, *render_condvar), &theme.output_image_loader, &render_mutex, surface_start_x += surface_start_x_offset
+                                 {new_socket, loop, backend, toplevel, keyboard, client_render_dirty, &theme.output_image_loader, &presentation_feedback, &opaque_regions, &scene_gate, surface_start_x += surface_start_x_offset
                                   , surface_start_y += surface_start_y_offset};
                                if (!focused) focused = c;
                                vwm::ui::detail::wait (loop, new_socket, UV_READABLE | UV_DISCONNECT,
                                                       [loop, c, &focused] (uv_poll_t* handle, int event)
                                                       {
-                                                        std::cout << "can be read" << std::endl;
+                                                        VWM_LOG (trace, main, "can be read");
 
                                                         try
                                                         {
@@ -323,7 +453,7 @@ int main(void) {
                                                         }
                                                         catch (std::exception const& e)
                                                         {
-                                                          std::cout << "Error with client: " << e.what() << std::endl;
+                                                          VWM_LOG (error, main, "Error with client: " << e.what());
                                                           uv_poll_stop (handle);
                                                           uv_close (static_cast<uv_handle_t*>(static_cast<void*>(handle)), /*& ::close*/NULL);
                                                           close (c->fd);
@@ -333,27 +463,131 @@ int main(void) {
                                                       });
                              });
 
-    {
-      // char socket[512];
-      // sprintf (socket, "%d", fd);
-      //std::cout << "socket: " << socket << std::endl;
-      setenv("WAYLAND_DISPLAY", /*socket*/"wayland-0", 1);
-    }
-  }
+  };
+
+  // the theme images are attached in the loop thread as they decode,
+  // the loop runs meanwhile
+  bool background_attached = false;
+  auto theme_decoded = std::make_shared<vwm::ui::detail::async_notifier>
+    (&loop, [&]
+     {
+       try
+       {
+         if (!background_attached && background.is_ready())
+         {
+           background_attached = true;
+           // clients are accepted once the background is below them
+           scene_gate.change
+             ([&]
+              {
+                auto const& background_img = background.get();
+                w.append_component ({0, 0
+                                     , static_cast<int32_t>(w.window.voutput.swapChainExtent.width)
+                                     , static_cast<int32_t>(w.window.voutput.swapChainExtent.height)
+                                     , ftk::ui::image_component{background_img.image_view}});
+                w.append_component ({100, 100, 160, 90, ftk::ui::image_component{background_img.image_view}});
+                if (cursor)
+                  cursor->keep_on_top();
+                render_dirty();
+                accept_clients();
+              });
+         }
+         if (!cursor && mouse_cursor.is_ready())
+           cursor.emplace (&loop, w, mouse_cursor.get().image_view, 32, 32, render_dirty
+                           , &presentation_feedback, &scene_gate);
+       }
+       catch (std::exception const& e)
+       {
+         VWM_LOG (error, main, "Error loading theme: " << e.what());
+         uv_stop (&loop);
+       }
+     });
+  auto const notify_decoded = [theme_decoded] (pc::shared_future<ftk::ui::backend::vulkan_image> const&)
+                              {
+                                theme_decoded->notify();
+                              };
+  pc::future<void> background_decoded = background.then (notify_decoded)
+    , mouse_cursor_decoded = mouse_cursor.then (notify_decoded);
 
   // draw (backend, w);
-  
-  auto thread = vwm::render_thread (&w, dirty, exit, render_mutex, condvar);
 
   auto r = uv_run (&loop, UV_RUN_DEFAULT);
-  std::cout << "uv_run return " << r << std::endl;
-
-  vwm::render_exit (exit, render_mutex, condvar)();
-  thread.join();
+  VWM_LOG (info, main, "uv_run return " << r);
+
+  stop_render_thread();
+  theme_decoded->close();
+  scene_gate_open->close();
+  if (cursor)
+    cursor->close();
+  presentation_feedback.close();
+
+  auto const statistics = render_metrics.statistics();
+  std::cout << "GPU time of the last " << statistics.total.samples << " frames up to frame "
+            << statistics.last_frame << std::endl
+            << "  filler passes: " << statistics.filler << std::endl
+            << "  image passes: " << statistics.image << std::endl
+            << "  regions: " << statistics.region << std::endl
+            << "  frames: " << statistics.total << std::endl
+            << "  graphics queue wait: " << statistics.queue_wait << std::endl;
+  using std::chrono::milliseconds;
+  std::cout << "time to first frame: "
+            << std::chrono::duration_cast<milliseconds>(time_to_first_frame).count() << "ms" << std::endl
+            << "time to first client frame: ";
+  if (time_to_first_client_frame.count())
+    std::cout << std::chrono::duration_cast<milliseconds>(time_to_first_client_frame).count() << "ms" << std::endl;
+  else
+    std::cout << "no client frame" << std::endl;
   return 0;
   } catch (std::exception const& e)
   {
-    std::cout << "Exception was thrown " << e.what() << std::endl;
+    VWM_LOG (error, main, "Exception was thrown " << e.what());
     return -1;
   }
 }
+
+// vwm [--headless] [--size WIDTHxHEIGHT] [--refresh HZ] [--frames N]
+//     [--readback FRAME:PATH] [--single-pass]
+int main (int argc, char* argv[])
+{
+  run_options options;
+  bool headless = false;
+  for (int i = 1; i != argc; ++i)
+  {
+    std::string const arg = argv[i];
+    char const* value = i + 1 != argc ? argv[i + 1] : nullptr;
+    if (arg == "--headless")
+      headless = true;
+    else if (arg == "--single-pass")
+      options.single_pass = true;
+    else if (arg == "--size" && value
+             && std::sscanf (value, "%ux%u", &options.width, &options.height) == 2)
+      ++i;
+    else if (arg == "--refresh" && value && std::atof (value) > 0)
+    {
+      options.refresh = std::chrono::nanoseconds (static_cast<std::int64_t>(1e9 / std::atof (value)));
+      ++i;
+    }
+    else if (arg == "--frames" && value)
+    {
+      options.frames = std::strtoull (value, nullptr, 10);
+      ++i;
+    }
+    else if (arg == "--readback" && value && std::strchr (value, ':'))
+    {
+      options.readback_frame = std::strtoull (value, nullptr, 10);
+      options.readback_path = std::strchr (value, ':') + 1;
+      ++i;
+    }
+    else
+    {
+      std::cout << "usage: " << argv[0] << " [--headless] [--size WIDTHxHEIGHT] [--refresh HZ]"
+                   " [--frames N] [--readback FRAME:PATH] [--single-pass]" << std::endl;
+      return -1;
+    }
+  }
+
+  if (headless)
+    return run<vwm::backend::headless::surface<ftk::ui::backend::uv>> (options);
+  else
+    return run<ftk::ui::backend::xlib_surface<ftk::ui::backend::uv>> (options);
+}
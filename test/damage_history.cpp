@@ -0,0 +1,40 @@
+///////////////////////////////////////////////////////////////////////////////
+//
+// Copyright 2019 Felipe Magno de Almeida.
+// Distributed under the Boost Software License, Version 1.0. (See
+// accompanying file LICENSE_1_0.txt or copy at
+// http://www.boost.org/LICENSE_1_0.txt)
+// See http://www.boost.org/libs/foreach for documentation
+//
+
+#include <vwm/damage_history.hpp>
+
+#include <boost/core/lightweight_test.hpp>
+
+int main ()
+{
+  using vwm::rect;
+  using vwm::region;
+  rect const extents {0, 0, 100, 100};
+  vwm::damage_history history (2, 4);
+
+  // images never rendered are repainted whole
+  BOOST_TEST_EQ (history.frame_damage (0, region (rect{0, 0, 10, 10}), extents).area(), 10000);
+  BOOST_TEST_EQ (history.frame_damage (1, region (rect{20, 0, 10, 10}), extents).area(), 10000);
+
+  // image 0 holds frame 1, so it repaints the damage of frames 2 and 3
+  auto const repaint = history.frame_damage (0, region (rect{40, 0, 10, 10}), extents);
+  BOOST_TEST_EQ (repaint.area(), 200);
+  BOOST_TEST (repaint.contains (rect{20, 0, 10, 10}));
+  BOOST_TEST (repaint.contains (rect{40, 0, 10, 10}));
+  BOOST_TEST (!repaint.intersects (rect{0, 0, 10, 10}));
+
+  // an image older than the history is repainted whole
+  vwm::damage_history short_history (2, 1);
+  short_history.frame_damage (0, region (rect{0, 0, 10, 10}), extents);
+  short_history.frame_damage (1, region (rect{0, 0, 10, 10}), extents);
+  short_history.frame_damage (1, region (rect{0, 0, 10, 10}), extents);
+  BOOST_TEST_EQ (short_history.frame_damage (0, region (rect{0, 0, 10, 10}), extents).area(), 10000);
+
+  return boost::report_errors();
+}
@@ -0,0 +1,82 @@
+///////////////////////////////////////////////////////////////////////////////
+//
+// Copyright 2019 Felipe Magno de Almeida.
+// Distributed under the Boost Software License, Version 1.0. (See
+// accompanying file LICENSE_1_0.txt or copy at
+// http://www.boost.org/LICENSE_1_0.txt)
+// See http://www.boost.org/libs/foreach for documentation
+//
+
+#include <vwm/frame_scheduler.hpp>
+
+#include <boost/core/lightweight_test.hpp>
+
+int main ()
+{
+  using namespace std::chrono_literals;
+  typedef vwm::frame_scheduler::clock clock;
+  clock::time_point const t0 {1s};
+
+  vwm::frame_scheduler_options options;
+  options.refresh = 10ms;
+  options.min_margin = 1ms;
+  options.slack = 1ms;
+
+  // without a vblank, frames start at once
+  {
+    vwm::frame_scheduler scheduler (options);
+    BOOST_TEST (scheduler.deadline (t0) == t0);
+    BOOST_TEST (scheduler.next_vblank (t0) == t0);
+    BOOST_TEST (scheduler.margin() == 1ms);
+  }
+
+  // the render time grows at once and shrinks slowly
+  {
+    vwm::frame_scheduler scheduler (options);
+    scheduler.frame_finished (t0, 4ms);
+    BOOST_TEST (scheduler.render_time() == 4ms);
+    BOOST_TEST (scheduler.margin() == 5ms);
+    scheduler.frame_finished (t0, 0ms);
+    BOOST_TEST (scheduler.render_time() == 3750us);
+    // the margin never exceeds a refresh
+    scheduler.frame_finished (t0, 50ms);
+    BOOST_TEST (scheduler.margin() == 10ms);
+  }
+
+  // composition starts margin before the predicted vblank
+  {
+    vwm::frame_scheduler scheduler (options);
+    scheduler.frame_finished (t0, 2ms);
+    scheduler.presented (t0);
+    BOOST_TEST (scheduler.next_vblank (t0 + 1ms) == t0 + 10ms);
+    BOOST_TEST (scheduler.deadline (t0 + 1ms) == t0 + 7ms);
+    // late for the next vblank, composes now
+    BOOST_TEST (scheduler.deadline (t0 + 9ms) == t0 + 9ms);
+
+    // a frame targeting a vblank makes the next one target the one after
+    scheduler.frame_started (t0 + 7ms);
+    BOOST_TEST (scheduler.target_vblank() == t0 + 10ms);
+    BOOST_TEST (scheduler.next_vblank (t0 + 7ms) == t0 + 20ms);
+
+    BOOST_TEST (scheduler.vblank_after (t0 + 10ms) == t0 + 10ms);
+    BOOST_TEST (scheduler.vblank_after (t0 + 11ms) == t0 + 20ms);
+    BOOST_TEST_EQ (scheduler.sequence (t0 + 20ms), 2u);
+  }
+
+  // presented vblanks refine the refresh unless the engine reported it
+  {
+    vwm::frame_scheduler scheduler (options);
+    scheduler.presented (t0);
+    scheduler.presented (t0 + 12ms);
+    BOOST_TEST (scheduler.refresh() > 10ms);
+    BOOST_TEST_EQ (scheduler.sequence (t0 + 12ms), 1u);
+
+    vwm::frame_scheduler exact (options);
+    exact.refresh (10ms);
+    exact.presented (t0);
+    exact.presented (t0 + 12ms);
+    BOOST_TEST (exact.refresh() == 10ms);
+  }
+
+  return boost::report_errors();
+}
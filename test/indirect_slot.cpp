@@ -0,0 +1,37 @@
+///////////////////////////////////////////////////////////////////////////////
+//
+// Copyright 2019 Felipe Magno de Almeida.
+// Distributed under the Boost Software License, Version 1.0. (See
+// accompanying file LICENSE_1_0.txt or copy at
+// http://www.boost.org/LICENSE_1_0.txt)
+// See http://www.boost.org/libs/foreach for documentation
+//
+
+#include <vwm/indirect_slot.hpp>
+
+#include <boost/core/lightweight_test.hpp>
+
+int main ()
+{
+  using vwm::rect;
+  using vwm::detail::render_thread_slot_entries;
+
+  std::vector<rect> const bounds
+    {{0, 0, 100, 100}, {200, 0, 10, 10}, {50, 50, 10, 10}, {300, 300, 10, 10}};
+
+  BOOST_TEST_EQ (render_thread_slot_entries ({}, {0, 0, 10, 10}), 0u);
+  // dirty up to the last overlapping component, not past it
+  BOOST_TEST_EQ (render_thread_slot_entries (bounds, {0, 0, 10, 10}), 1u);
+  BOOST_TEST_EQ (render_thread_slot_entries (bounds, {55, 55, 1, 1}), 3u);
+  BOOST_TEST_EQ (render_thread_slot_entries (bounds, {205, 5, 1, 1}), 2u);
+  BOOST_TEST_EQ (render_thread_slot_entries (bounds, {0, 0, 400, 400}), 4u);
+  // touching edges do not overlap
+  BOOST_TEST_EQ (render_thread_slot_entries (bounds, {100, 100, 10, 10}), 0u);
+  BOOST_TEST_EQ (render_thread_slot_entries (bounds, {290, 290, 10, 10}), 0u);
+
+  // the slot holds 4096 entries at most
+  std::vector<rect> const many (5000, rect{0, 0, 10, 10});
+  BOOST_TEST_EQ (render_thread_slot_entries (many, {0, 0, 1, 1}), 4096u);
+
+  return boost::report_errors();
+}
@@ -0,0 +1,42 @@
+///////////////////////////////////////////////////////////////////////////////
+//
+// Copyright 2019 Felipe Magno de Almeida.
+// Distributed under the Boost Software License, Version 1.0. (See
+// accompanying file LICENSE_1_0.txt or copy at
+// http://www.boost.org/LICENSE_1_0.txt)
+// See http://www.boost.org/libs/foreach for documentation
+//
+
+#include <vwm/log.hpp>
+
+#include <boost/core/lightweight_test.hpp>
+
+int main ()
+{
+  using vwm::log::level;
+  using vwm::log::subsystem;
+  vwm::log::logger logger;
+
+  logger.configure ("warning");
+  BOOST_TEST (!logger.enabled (level::info, subsystem::render));
+  BOOST_TEST (logger.enabled (level::warning, subsystem::render));
+  BOOST_TEST (logger.enabled (level::error, subsystem::wayland));
+
+  // later items override earlier ones, per subsystem
+  logger.configure ("error,render=debug,wayland=trace");
+  BOOST_TEST (logger.enabled (level::debug, subsystem::render));
+  BOOST_TEST (!logger.enabled (level::trace, subsystem::render));
+  BOOST_TEST (logger.enabled (level::trace, subsystem::wayland));
+  BOOST_TEST (!logger.enabled (level::warning, subsystem::main));
+
+  // unknown levels and subsystems are ignored
+  logger.configure ("render=loud,nowhere=trace,,verbose");
+  BOOST_TEST (logger.enabled (level::debug, subsystem::render));
+  BOOST_TEST (!logger.enabled (level::warning, subsystem::main));
+
+  logger.configure ("off");
+  BOOST_TEST (!logger.enabled (level::error, subsystem::main));
+  BOOST_TEST (!logger.enabled (level::error, subsystem::backend));
+
+  return boost::report_errors();
+}
@@ -0,0 +1,64 @@
+///////////////////////////////////////////////////////////////////////////////
+//
+// Copyright 2019 Felipe Magno de Almeida.
+// Distributed under the Boost Software License, Version 1.0. (See
+// accompanying file LICENSE_1_0.txt or copy at
+// http://www.boost.org/LICENSE_1_0.txt)
+// See http://www.boost.org/libs/foreach for documentation
+//
+
+#include <vwm/motion_history.hpp>
+
+#include <boost/core/lightweight_test.hpp>
+
+#include <vector>
+
+int main ()
+{
+  using vwm::motion_history;
+  using vwm::motion_sample;
+
+  // a capacity of 0 records nothing
+  {
+    motion_history h;
+    BOOST_TEST (!h.enabled());
+    h.record (1, 10, 10);
+    h.record (2, 20, 20);
+    BOOST_TEST_EQ (h.size(), 0u);
+  }
+
+  // the first position only sets the origin of the deltas
+  {
+    motion_history h (4);
+    BOOST_TEST (h.enabled());
+    h.record (1, 10, 10);
+    BOOST_TEST_EQ (h.size(), 0u);
+    h.record (2, 13, 8);
+    h.record (3, 13, 9);
+    std::vector<motion_sample> samples;
+    h.consume ([&] (motion_sample const& s) { samples.push_back (s); });
+    BOOST_TEST_EQ (samples.size(), 2u);
+    BOOST_TEST_EQ (samples[0].time, 2u);
+    BOOST_TEST_EQ (samples[0].dx, 3);
+    BOOST_TEST_EQ (samples[0].dy, -2);
+    BOOST_TEST_EQ (samples[1].dx, 0);
+    BOOST_TEST_EQ (samples[1].dy, 1);
+    BOOST_TEST_EQ (h.size(), 0u);
+
+    // deltas continue from the last position after consume
+    h.record (4, 14, 9);
+    h.consume ([&] (motion_sample const& s) { BOOST_TEST_EQ (s.dx, 1); });
+  }
+
+  // only the last capacity samples are kept, oldest first
+  {
+    motion_history h (2);
+    for (std::int32_t i = 0; i != 5; ++i)
+      h.record (i, i * i, 0);
+    std::vector<std::uint32_t> times;
+    h.consume ([&] (motion_sample const& s) { times.push_back (s.time); });
+    BOOST_TEST ((times == std::vector<std::uint32_t>{3, 4}));
+  }
+
+  return boost::report_errors();
+}
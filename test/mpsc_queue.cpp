@@ -0,0 +1,71 @@
+///////////////////////////////////////////////////////////////////////////////
+//
+// Copyright 2019 Felipe Magno de Almeida.
+// Distributed under the Boost Software License, Version 1.0. (See
+// accompanying file LICENSE_1_0.txt or copy at
+// http://www.boost.org/LICENSE_1_0.txt)
+// See http://www.boost.org/libs/foreach for documentation
+//
+
+#include <vwm/mpsc_queue.hpp>
+
+#include <boost/core/lightweight_test.hpp>
+
+#include <memory>
+#include <thread>
+#include <vector>
+
+int main ()
+{
+  {
+    vwm::mpsc_queue<int> queue;
+    BOOST_TEST (queue.empty());
+    BOOST_TEST (!queue.pop());
+    queue.push (1);
+    queue.push (2);
+    BOOST_TEST (!queue.empty());
+    BOOST_TEST_EQ (*queue.pop(), 1);
+    BOOST_TEST (!queue.empty());
+    BOOST_TEST_EQ (*queue.pop(), 2);
+    BOOST_TEST (queue.empty());
+    BOOST_TEST (!queue.pop());
+  }
+
+  // values left in the queue are destroyed with it
+  {
+    auto value = std::make_shared<int>(0);
+    {
+      vwm::mpsc_queue<std::shared_ptr<int>> queue;
+      queue.push (value);
+      queue.push (value);
+      BOOST_TEST_EQ (value.use_count(), 3);
+    }
+    BOOST_TEST_EQ (value.use_count(), 1);
+  }
+
+  // every producer's values arrive once and in its order
+  {
+    int const producers = 4, count = 100000;
+    vwm::mpsc_queue<std::pair<int, int>> queue;
+    std::vector<std::thread> threads;
+    for (int p = 0; p != producers; ++p)
+      threads.emplace_back ([&queue, p] { for (int i = 0; i != count; ++i) queue.push ({p, i}); });
+
+    std::vector<int> next (producers, 0);
+    int received = 0;
+    bool ordered = true;
+    while (received != producers * count)
+      if (auto v = queue.pop())
+      {
+        ordered = ordered && v->second == next[v->first];
+        next[v->first] = v->second + 1;
+        ++received;
+      }
+    for (auto&& thread : threads)
+      thread.join();
+    BOOST_TEST (ordered);
+    BOOST_TEST (queue.empty());
+  }
+
+  return boost::report_errors();
+}
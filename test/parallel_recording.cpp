@@ -0,0 +1,90 @@
+///////////////////////////////////////////////////////////////////////////////
+//
+// Copyright 2019 Felipe Magno de Almeida.
+// Distributed under the Boost Software License, Version 1.0. (See
+// accompanying file LICENSE_1_0.txt or copy at
+// http://www.boost.org/LICENSE_1_0.txt)
+// See http://www.boost.org/libs/foreach for documentation
+//
+
+#include <vwm/parallel_recording.hpp>
+
+#include <boost/core/lightweight_test.hpp>
+
+#include <atomic>
+#include <deque>
+#include <thread>
+
+int main ()
+{
+  using vwm::detail::render_thread_record_parallel;
+
+  // every worker is recorded once, by the executor or inline
+  {
+    std::mutex mutex;
+    std::deque<std::function<void()>> tasks;
+    std::atomic<bool> stop {false};
+    std::thread executor ([&]
+                          {
+                            while (!stop)
+                            {
+                              std::function<void()> task;
+                              {
+                                std::unique_lock<std::mutex> l (mutex);
+                                if (!tasks.empty())
+                                {
+                                  task = std::move (tasks.front());
+                                  tasks.pop_front();
+                                }
+                              }
+                              if (task)
+                                task();
+                              else
+                                std::this_thread::yield();
+                            }
+                          });
+    auto const post = [&] (std::function<void()> f)
+                      {
+                        std::unique_lock<std::mutex> l (mutex);
+                        tasks.push_back (std::move (f));
+                      };
+    bool once = true;
+    for (int frame = 0; frame != 1000; ++frame)
+    {
+      std::atomic<int> recorded[4] = {};
+      render_thread_record_parallel (post, 4, [&] (std::size_t worker) { ++recorded[worker]; });
+      for (auto&& r : recorded)
+        once = once && r == 1;
+    }
+    BOOST_TEST (once);
+
+    bool thrown = false;
+    try
+    {
+      render_thread_record_parallel (post, 3, [] (std::size_t worker) { if (worker == 2) throw 2; });
+    }
+    catch (int)
+    {
+      thrown = true;
+    }
+    BOOST_TEST (thrown);
+
+    stop = true;
+    executor.join();
+  }
+
+  // a saturated executor that never starts the tasks does not hold the
+  // caller, tasks starting afterwards do nothing
+  {
+    std::vector<std::function<void()>> held;
+    int recorded[3] = {};
+    render_thread_record_parallel ([&] (std::function<void()> f) { held.push_back (std::move (f)); }
+                                   , 3, [&] (std::size_t worker) { ++recorded[worker]; });
+    for (auto&& task : held)
+      task();
+    for (auto r : recorded)
+      BOOST_TEST_EQ (r, 1);
+  }
+
+  return boost::report_errors();
+}
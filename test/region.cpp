@@ -0,0 +1,92 @@
+///////////////////////////////////////////////////////////////////////////////
+//
+// Copyright 2019 Felipe Magno de Almeida.
+// Distributed under the Boost Software License, Version 1.0. (See
+// accompanying file LICENSE_1_0.txt or copy at
+// http://www.boost.org/LICENSE_1_0.txt)
+// See http://www.boost.org/libs/foreach for documentation
+//
+
+#include <vwm/region.hpp>
+
+#include <boost/core/lightweight_test.hpp>
+
+int main ()
+{
+  using vwm::rect;
+  using vwm::region;
+
+  {
+    region r;
+    BOOST_TEST (r.empty());
+    BOOST_TEST_EQ (r.area(), 0);
+    r.unite (rect{0, 0, 10, 10});
+    BOOST_TEST_EQ (r.area(), 100);
+    BOOST_TEST_EQ (r.rect_count(), 1u);
+  }
+
+  // overlapping rects are counted once
+  {
+    region r (rect{0, 0, 10, 10});
+    r.unite (rect{5, 5, 10, 10});
+    BOOST_TEST_EQ (r.area(), 175);
+    auto const e = r.extents();
+    BOOST_TEST_EQ (e.x, 0);
+    BOOST_TEST_EQ (e.y, 0);
+    BOOST_TEST_EQ (e.width, 15);
+    BOOST_TEST_EQ (e.height, 15);
+    std::int64_t area = 0;
+    for (auto&& r : r.rects())
+      area += static_cast<std::int64_t>(r.width) * r.height;
+    BOOST_TEST_EQ (area, 175);
+  }
+
+  // adjacent rects merge into a single band
+  {
+    region r (rect{0, 0, 10, 10});
+    r.unite (rect{0, 10, 10, 10});
+    BOOST_TEST_EQ (r.rect_count(), 1u);
+    BOOST_TEST (r.contains (rect{0, 0, 10, 20}));
+  }
+
+  {
+    region r (rect{0, 0, 10, 10});
+    r.subtract (rect{0, 0, 10, 5});
+    BOOST_TEST_EQ (r.area(), 50);
+    BOOST_TEST (!r.intersects (rect{0, 0, 10, 5}));
+    BOOST_TEST (r.intersects (rect{0, 5, 1, 1}));
+    r.subtract (rect{0, 0, 10, 10});
+    BOOST_TEST (r.empty());
+  }
+
+  {
+    region r (rect{0, 0, 10, 10});
+    r.intersect (rect{5, 5, 10, 10});
+    BOOST_TEST_EQ (r.area(), 25);
+    r.translate (-5, -5);
+    BOOST_TEST (r.contains (rect{0, 0, 5, 5}));
+  }
+
+  // a hole is kept as separate rects, simplify gives the extents when
+  // they cost less than the rects
+  {
+    region r (rect{0, 0, 30, 30});
+    r.subtract (rect{10, 10, 10, 10});
+    BOOST_TEST_EQ (r.area(), 800);
+    BOOST_TEST_GT (r.rect_count(), 1u);
+    auto const simple = vwm::simplify (r, 1, 0);
+    BOOST_TEST_EQ (simple.rect_count(), 1u);
+    BOOST_TEST (simple.contains (rect{0, 0, 30, 30}));
+  }
+
+  // the same area built differently compares equal
+  {
+    region a (rect{0, 0, 10, 20}), b (rect{0, 0, 10, 10});
+    b.unite (rect{0, 10, 10, 10});
+    BOOST_TEST (a == b);
+    b.subtract (rect{0, 0, 1, 1});
+    BOOST_TEST (a != b);
+  }
+
+  return boost::report_errors();
+}
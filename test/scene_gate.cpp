@@ -0,0 +1,136 @@
+///////////////////////////////////////////////////////////////////////////////
+//
+// Copyright 2019 Felipe Magno de Almeida.
+// Distributed under the Boost Software License, Version 1.0. (See
+// accompanying file LICENSE_1_0.txt or copy at
+// http://www.boost.org/LICENSE_1_0.txt)
+// See http://www.boost.org/libs/foreach for documentation
+//
+
+#include <vwm/scene_gate.hpp>
+
+#include <boost/core/lightweight_test.hpp>
+
+#include <atomic>
+#include <condition_variable>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+int main ()
+{
+  {
+    std::atomic<int> woken {0};
+    vwm::scene_gate gate ([&] { ++woken; });
+
+    // frames share the gate
+    BOOST_TEST (gate.try_use());
+    BOOST_TEST (gate.try_use());
+
+    // changes wait for the frames in use, in order, without blocking
+    std::vector<int> changes;
+    gate.change ([&] { changes.push_back (1); });
+    gate.change ([&] { changes.push_back (2); });
+    BOOST_TEST (!gate.try_lock());
+    BOOST_TEST (changes.empty());
+    BOOST_TEST_EQ (woken, 0);
+
+    // no frame starts while changes wait
+    BOOST_TEST (!gate.try_use());
+    gate.release();
+    BOOST_TEST_EQ (woken, 0);
+    gate.dispatch();
+    BOOST_TEST (changes.empty());
+    gate.release();
+    BOOST_TEST_EQ (woken, 1);
+
+    int retried = 0;
+    auto retry = gate.connect ([&] { ++retried; });
+    gate.dispatch();
+    BOOST_TEST ((changes == std::vector<int>{1, 2}));
+    BOOST_TEST_EQ (retried, 1);
+
+    // a free gate changes right away
+    gate.change ([&] { changes.push_back (3); });
+    BOOST_TEST_EQ (changes.size(), 3u);
+    BOOST_TEST (gate.try_lock());
+    gate.unlock();
+    gate.disconnect (retry);
+
+    // frames no longer wait for a closed gate
+    BOOST_TEST (gate.try_use());
+    gate.change ([&] { changes.push_back (4); });
+    gate.close();
+    BOOST_TEST (gate.try_use());
+    gate.release();
+    gate.release();
+    BOOST_TEST_EQ (changes.size(), 3u);
+  }
+
+  // the loop thread changes nothing while frames use the scene, and a
+  // render thread that retires its frames whenever try_use fails lets
+  // its changes in
+  {
+    std::mutex mutex;
+    std::condition_variable woken;
+    bool wake = false;
+    vwm::scene_gate gate ([&]
+                          {
+                            {
+                              std::unique_lock<std::mutex> l (mutex);
+                              wake = true;
+                            }
+                            woken.notify_one();
+                          });
+    std::atomic<bool> changing {false}, stop {false}, overlapped {false};
+    std::thread render ([&]
+                        {
+                          std::size_t in_flight = 0;
+                          while (!stop)
+                          {
+                            while (!gate.try_use())
+                            {
+                              gate.release();
+                              --in_flight;
+                            }
+                            ++in_flight;
+                            if (changing)
+                              overlapped = true;
+                            if (in_flight == 2)
+                            {
+                              gate.release();
+                              --in_flight;
+                            }
+                          }
+                          while (in_flight--)
+                            gate.release();
+                        });
+    int changes = 0;
+    for (int i = 0; i != 10000; ++i)
+    {
+      gate.change ([&]
+                   {
+                     changing = true;
+                     ++changes;
+                     changing = false;
+                   });
+      if (i % 100 == 99)
+        while (changes != i + 1)
+        {
+          {
+            std::unique_lock<std::mutex> l (mutex);
+            woken.wait (l, [&] { return wake; });
+            wake = false;
+          }
+          gate.dispatch();
+        }
+    }
+    stop = true;
+    gate.close();
+    render.join();
+    BOOST_TEST (!overlapped);
+    BOOST_TEST_EQ (changes, 10000);
+  }
+
+  return boost::report_errors();
+}
@@ -17,17 +17,27 @@
 #include <vwm/wayland/drm.hpp>
 #include <vwm/wayland/dmabuf.hpp>
 
+#include <vwm/presentation_feedback.hpp>
+#include <vwm/opaque_regions.hpp>
+#include <vwm/scene_gate.hpp>
+#include <vwm/region.hpp>
+#include <vwm/log.hpp>
+#include <vwm/uv/detail/async.hpp>
+
 #include <ftk/ui/backend/vulkan_load.hpp>
 
 #include "wayland_header.hpp"
 
 #include <deque>
+#include <iterator>
+#include <memory>
 #include <vector>
 
 #include <sys/mman.h>
 
 //#include <sys/syslimits.h>
 #include <fcntl.h>
+#include <time.h>
 
 #include <png.h>
 #include <xkbcommon/xkbcommon.h>
@@ -55,38 +65,95 @@ struct client
   std::uint32_t output_id, keyboard_id, focused_surface_id, old_focused_surface_id;
   std::uint32_t last_surface_entered_id;
   Keyboard* keyboard;
-  std::function<void()> render_dirty;
+  // returns the number of the scene pushed
+  std::function<std::uint64_t()> render_dirty;
   ftk::ui::backend::vulkan_image_loader<Executor>* image_loader;
-  std::mutex* render_mutex;
+  vwm::presentation_feedback* feedback;
+  vwm::presentation_feedback::connection feedback_connection;
+  vwm::opaque_regions* opaque_regions;
+  // held while the toplevel changes and its scene is pushed
+  vwm::scene_gate* gate;
+  vwm::scene_gate::connection gate_connection;
+  std::shared_ptr<vwm::ui::detail::async_notifier> uploads_done;
   std::int32_t surface_start_x = 0, surface_start_y = 0;
   std::int32_t surface_start_x_offset = 30, surface_start_y_offset = 30;
 
   using token_type = pc::future<ftk::ui::backend::vulkan_image>;
-  using surface_type = surface<token_type, typename ftk::ui::toplevel_window<backend_type>::component_iterator>;
+  // state latched by wl_surface.commit
+  struct surface_commit
+  {
+    std::size_t buffer_id;
+    std::int32_t width, height;
+    // invalid when the commit has no shm buffer
+    pc::shared_future<ftk::ui::backend::vulkan_image> upload;
+    // notifies uploads_done once upload is ready
+    pc::future<void> uploaded;
+    vwm::region opaque;
+    std::vector<std::uint32_t> frame_callbacks, presentation_feedbacks;
+  };
+  using surface_type = surface<token_type, typename ftk::ui::toplevel_window<backend_type>::component_iterator
+                               , surface_commit>;
 
   client (int fd, uv_loop_t* loop, backend_type* backend, ftk::ui::toplevel_window<backend_type&>* toplevel
-          , Keyboard* keyboard, std::function<void()> render_dirty
+          , Keyboard* keyboard, std::function<std::uint64_t()> render_dirty
           , ftk::ui::backend::vulkan_image_loader<Executor>* image_loader
-          , std::mutex* render_mutex
+          , vwm::presentation_feedback* feedback
+          , vwm::opaque_regions* opaque_regions
+          , vwm::scene_gate* gate
           , std::int32_t surface_start_x = 0, std::int32_t surface_start_y = 0)
     : fd(fd), buffer_first(0), buffer_last(0)
     , current_message_size (-1), loop(loop), backend(backend), toplevel(toplevel), serial (0u), output_id(0u), keyboard_id (0u)
     , old_focused_surface_id (0u), last_surface_entered_id (0u)
     , keyboard (keyboard), render_dirty (render_dirty), image_loader (image_loader)
-    , render_mutex (render_mutex), surface_start_x (surface_start_x)
+    , feedback (feedback), opaque_regions (opaque_regions), gate (gate)
+    , surface_start_x (surface_start_x)
     , surface_start_y (surface_start_y)
   {
-    std::cout << "keyboard " << keyboard << std::endl;
+    VWM_LOG (debug, wayland, "keyboard " << keyboard);
     client_objects.push_back({vwm::wayland::generated::interface_::wl_display});
+    uploads_done = std::make_shared<vwm::ui::detail::async_notifier>
+      (loop, [this]
+             {
+               if (gate->try_lock())
+               {
+                 std::unique_lock<vwm::scene_gate> changing (*gate, std::adopt_lock);
+                 apply_latched_commits();
+               }
+             });
+    gate_connection = gate->connect ([this] { apply_latched_commits(); });
+    feedback_connection = feedback->connect
+      ([this] (vwm::presented_frame const& frame)
+       {
+         try
+         {
+           frame_presented (frame);
+           presentation_presented (frame);
+         }
+         catch (std::exception const& e)
+         {
+           // a broken connection is dropped when its socket is read
+           VWM_LOG (error, wayland, "Error sending frame callbacks: " << e.what());
+         }
+       });
   }
 
+  ~client ()
+  {
+    feedback->disconnect (feedback_connection);
+    gate->disconnect (gate_connection);
+    uploads_done->close();
+  }
+
+  client (client const&) = delete;
+  client& operator= (client const&) = delete;
+
   struct empty {};
   
   struct object
   {
     vwm::wayland::generated::interface_ interface_ = vwm::wayland::generated::interface_::empty;
 
-    std::variant<empty, shm_pool, shm_buffer*, surface_type, drm, dma_buffer, dma_params> data;
+    std::variant<empty, shm_pool, shm_buffer*, surface_type, drm, dma_buffer, dma_params, vwm::region> data;
   };
 
   typedef std::reference_wrapper<object> object_type;
@@ -114,7 +181,7 @@ struct client
   {
     if (client_id > client_objects.size())
     {
-      std::cout << "object " << client_id << " not found" << std::endl;
+      VWM_LOG (warning, wayland, "object " << client_id << " not found");
       throw 1.0f;
     }
 
@@ -122,7 +189,7 @@ struct client
     
     if (object.get().interface_ == vwm::wayland::generated::interface_::empty)
     {
-      std::cout << "object is empty" << std::endl;
+      VWM_LOG (warning, wayland, "object is empty");
       throw -1.0;
     }
     return object;
@@ -134,9 +201,16 @@ struct client
     return (ptr - &client_objects[0]) + 1;
   }
 
+  // for objects the server destroys, like wl_callback
+  void destroy_object (std::uint32_t client_id)
+  {
+    server_protocol().wl_display_delete_id (1, client_id);
+    client_objects[client_id - 1] = {};
+  }
+
   void add_object(uint32_t client_id, object obj)
   {
-    std::cout << "adding object with client_id " << client_id << std::endl;
+    VWM_LOG (trace, wayland, "adding object with client_id " << client_id);
 
     auto id = client_id - 1;
     
@@ -146,8 +220,8 @@ struct client
     {
       if (client_objects[id].interface_ != vwm::wayland::generated::interface_::empty)
       {
-        std::cout << "client_id " << client_id << " already used "
-                  << (int)client_objects[client_id].interface_ << std::endl;
+        VWM_LOG (warning, wayland, "client_id " << client_id << " already used "
+                  << (int)client_objects[client_id].interface_);
         throw (char)1;
       }
       else
@@ -157,7 +231,7 @@ struct client
     }
     else
     {
-      std::cout << "adding weird object " << client_id << " client_objects.size() " << client_objects.size() << std::endl;
+      VWM_LOG (warning, wayland, "adding weird object " << client_id << " client_objects.size() " << client_objects.size());
       throw -1;
     }
   }
@@ -192,9 +266,9 @@ struct client
     cmsg = CMSG_FIRSTHDR(&message);
 
     if (cmsg)
-      std::cout << "Has msg and len is " << cmsg->cmsg_len << " should be " << CMSG_LEN(sizeof(fd))
+      VWM_LOG (trace, wayland, "Has msg and len is " << cmsg->cmsg_len << " should be " << CMSG_LEN(sizeof(fd))
                 << " has level " << cmsg->cmsg_level << " type " << cmsg->cmsg_type
-                << " should have level " << SOL_SOCKET << " type " << SCM_RIGHTS << std::endl;
+                << " should have level " << SOL_SOCKET << " type " << SCM_RIGHTS);
 
     if (cmsg && cmsg->cmsg_len >= CMSG_LEN(sizeof(fd)))
     {
@@ -204,12 +278,12 @@ struct client
         unsigned int rest = cmsg->cmsg_len - CMSG_LEN(0);
         unsigned int off = 0;
 
-        std::cout << "rest " << rest << std::endl;
+        VWM_LOG (trace, wayland, "rest " << rest);
 
         while (rest >= sizeof(fd))
         {
-          std::cout << "rest " << rest << std::endl;
-          std::cout << "pushing new fd" << std::endl;
+          VWM_LOG (trace, wayland, "rest " << rest);
+          VWM_LOG (trace, wayland, "pushing new fd");
 
           int fd;
           memcpy(&fd, &CMSG_DATA(cmsg)[off], sizeof(fd));
@@ -225,21 +299,28 @@ struct client
 
   void connection_drop (std::error_code ec)
   {
-    std::cout << "connection_drop " << ec.message() << std::endl;
+    VWM_LOG (info, wayland, "connection_drop " << ec.message());
+    std::vector<typename surface_type::render_token_type> components;
     for (auto&& object : client_objects)
     {
       if (auto* s = std::get_if<surface_type>(&object.data))
       {
-        std::cout << "removing surface" << std::endl;
+        VWM_LOG (debug, wayland, "removing surface");
         if (s->render_token)
-        {
-          std::unique_lock<std::mutex> l(*render_mutex);
-          toplevel->remove_component (*s->render_token);
-          l.unlock();
-        }
+          components.push_back (*s->render_token);
       }
     }
-    render_dirty();
+    // the client is gone by the time frames in use retire
+    gate->change ([components = std::move (components), toplevel = toplevel
+                   , opaque_regions = opaque_regions, render_dirty = render_dirty]
+                  {
+                    for (auto&& component : components)
+                    {
+                      opaque_regions->erase (&*component);
+                      toplevel->remove_component (component);
+                    }
+                    render_dirty();
+                  });
     //close (fd);
     throw std::system_error (ec);
   }
@@ -270,7 +351,7 @@ struct client
       }
       else if (r == 0)
       {
-        std::cout << "read 0 errno " << errno << std::endl;
+        VWM_LOG (warning, wayland, "read 0 errno " << errno);
         //perror("");
         if (errno != EINTR)
           //exit(0);
@@ -437,7 +518,7 @@ struct client
 
   void wl_display_sync (object& obj, uint32_t new_id)
   {
-    std::cout << "wl_display_sync " << new_id << std::endl;
+    VWM_LOG (debug, wayland, "wl_display_sync " << new_id);
 
     add_object (new_id, {vwm::wayland::generated::interface_::empty});
     server_protocol().wl_callback_done (new_id, serial++);
@@ -446,7 +527,7 @@ struct client
   
   void wl_display_get_registry (object& obj, uint32_t new_id)
   {
-    std::cout << "wl_display_get_registry with new id " << new_id << std::endl;
+    VWM_LOG (debug, wayland, "wl_display_get_registry with new id " << new_id);
 
     add_object (new_id, {vwm::wayland::generated::interface_::wl_registry});
     server_protocol().wl_registry_global (new_id, 1,  "wl_compositor", 4);
@@ -460,12 +541,13 @@ struct client
     server_protocol().wl_registry_global (new_id, 8,  "wl_shell", 1);
     server_protocol().wl_registry_global (new_id, 9,  "zwp_linux_dmabuf_v1", 3);
     server_protocol().wl_registry_global (new_id, 10, "zwp_linux_explicit_synchronization_v1", 2);
+    server_protocol().wl_registry_global (new_id, 11, "wp_presentation", 1);
   }
 
   void wl_registry_bind (object& obj, uint32_t global_id, std::string_view interface, uint32_t version, uint32_t new_id)
   {
-    std::cout << "called bind for " << new_id << " interface |" << interface << "| " << interface.size()
-              << " last byte " << (int)interface[interface.size() -1] << " version " << version  << std::endl;
+    VWM_LOG (debug, wayland, "called bind for " << new_id << " interface |" << interface << "| " << interface.size()
+              << " last byte " << (int)interface[interface.size() -1] << " version " << version);
 
     if (interface == "wl_compositor")
       {
@@ -530,9 +612,14 @@ struct client
       {
         add_object (new_id, {vwm::wayland::generated::interface_::xdg_wm_base});
       }
+    else if (interface == "wp_presentation")
+      {
+        add_object (new_id, {vwm::wayland::generated::interface_::wp_presentation});
+        server_protocol().wp_presentation_clock_id (new_id, CLOCK_MONOTONIC);
+      }
     else if (interface == "wl_seat")
     {
-      std::cout << "registering wl_seat" << std::endl;
+      VWM_LOG (debug, wayland, "registering wl_seat");
       add_object (new_id, {vwm::wayland::generated::interface_::wl_seat});
       server_protocol().wl_seat_capabilities (new_id, 7);
       server_protocol().wl_seat_name (new_id, "default");
@@ -805,7 +892,7 @@ struct client
     }
     else
       {
-        std::cout << "none of the above?" << std::endl;
+        VWM_LOG (warning, wayland, "none of the above?");
       }
     
   }
@@ -821,18 +908,18 @@ struct client
 
   void wl_compositor_create_region (object& obj, uint32_t new_id)
   {
-    add_object (new_id, {vwm::wayland::generated::interface_::wl_region, {}});
+    add_object (new_id, {vwm::wayland::generated::interface_::wl_region, {vwm::region{}}});
   }
 
   void wl_shm_create_pool (object& obj, uint32_t new_id, int fd, uint32_t size)
   {
-    std::cout << "create pool with new_id " << new_id << " fd " << fd << " size " << size << std::endl;
+    VWM_LOG (debug, wayland, "create pool with new_id " << new_id << " fd " << fd << " size " << size);
 
     struct stat s;
     
     if (fstat(fd, &s) < 0) {
       //close(fd);
-      std::cout << "Failed to stat" << std::endl;
+      VWM_LOG (error, wayland, "Failed to stat");
     }
 
     void* buffer = ::mmap (NULL, size, PROT_READ, MAP_SHARED, fd, 0);
@@ -840,7 +927,7 @@ struct client
 
     assert (buffer != nullptr);
 
-    std::cout << "pool created with mmap starting at " << buffer << std::endl;
+    VWM_LOG (debug, wayland, "pool created with mmap starting at " << buffer);
     
     add_object (new_id, {vwm::wayland::generated::interface_::wl_shm_pool, {shm_pool{fd, buffer, size}}});
   }
@@ -851,9 +938,9 @@ struct client
     if (shm_pool* pool = std::get_if<shm_pool>(&obj.data))
     {
       pool->buffers.reserve(100);
-      std::cout << "offset " << offset << " width " << width << " height " << height << " stride " << stride << " format "
+      VWM_LOG (debug, wayland, "offset " << offset << " width " << width << " height " << height << " stride " << stride << " format "
                 << "buffers.pointer " << &pool->buffers[0]
-                << " pool mmap size " << pool->mmap_size << " mmap buffer " << (void*)(static_cast<char*>(pool->mmap_buffer) + offset) << std::endl;
+                << " pool mmap size " << pool->mmap_size << " mmap buffer " << (void*)(static_cast<char*>(pool->mmap_buffer) + offset));
 
       pool->buffers.push_back ({static_cast<char*>(pool->mmap_buffer) + offset, static_cast<uint32_t>(height)*stride, offset, width, height
                                 , stride, static_cast<enum format>(format)});
@@ -862,7 +949,7 @@ struct client
       assert (offset + static_cast<std::uint32_t>(height)*stride <= pool->mmap_size);
       
       add_object (new_id, {vwm::wayland::generated::interface_::wl_buffer, {&pool->buffers.back()}});
-      std::cout << "create buffer format " << format_description (static_cast<enum format>(format)) << " & " << &pool->buffers[0] << std::endl;
+      VWM_LOG (debug, wayland, "create buffer format " << format_description (static_cast<enum format>(format)) << " & " << &pool->buffers[0]);
     }
     else
       throw -1;
@@ -882,13 +969,13 @@ struct client
       
       pool->mmap_buffer = ::mmap (NULL, pool->mmap_size = size, PROT_READ, MAP_SHARED, pool->fd, 0);
       assert (pool->mmap_buffer != MAP_FAILED);
-      std::cout << "old  " << buffer << " new " << pool->mmap_buffer << std::endl;
+      VWM_LOG (debug, wayland, "old  " << buffer << " new " << pool->mmap_buffer);
 
       int i = 0;
       for (auto&& buffer : pool->buffers)
       {
-        std::cout << "old from buffer[" << i << "] " << buffer.mmap_buffer_offset << " new "
-                  << static_cast<void*>(static_cast<char*>(pool->mmap_buffer) + buffer.offset) << std::endl;
+        VWM_LOG (debug, wayland, "old from buffer[" << i << "] " << buffer.mmap_buffer_offset << " new "
+                  << static_cast<void*>(static_cast<char*>(pool->mmap_buffer) + buffer.offset));
         buffer.mmap_buffer_offset = static_cast<char*>(pool->mmap_buffer) + buffer.offset;
         ++i;
       }
@@ -939,11 +1026,62 @@ struct client
   void wl_shell_surface_set_fullscreen (object& obj, std::uint32_t, std::uint32_t, std::uint32_t) {}
   void wl_shell_surface_set_popup (object& obj, std::uint32_t, std::uint32_t, std::uint32_t, std::int32_t, std::int32_t, std::uint32_t) {}
   void wl_shell_surface_set_maximized (object& obj, std::uint32_t, std::uint32_t, std::uint32_t, std::int32_t, std::int32_t, std::uint32_t) {}
-  void wl_surface_destroy (object& obj) {}
+  // the component goes with the surface, so the toplevel can give its
+  // texture descriptor to the next surface instead of growing. It is
+  // removed through the gate, once no frame in use draws it
+  void wl_surface_destroy (object& obj)
+  {
+    auto const surface_id = get_object_id (&obj);
+    if (surface_type* s = std::get_if<surface_type>(&obj.data))
+    {
+      if (s->render_token)
+        gate->change ([component = *s->render_token, toplevel = toplevel
+                       , opaque_regions = opaque_regions, render_dirty = render_dirty]
+                      {
+                        opaque_regions->erase (&*component);
+                        toplevel->remove_component (component);
+                        render_dirty ();
+                      });
+      for (auto callback : s->pending_frame_callbacks)
+        destroy_object (callback);
+      for (auto&& callback : s->frame_callbacks)
+        destroy_object (callback.second);
+      for (auto callback : s->pending_presentation_feedbacks)
+      {
+        server_protocol().wp_presentation_feedback_discarded (callback);
+        destroy_object (callback);
+      }
+      for (auto&& callback : s->presentation_feedbacks)
+      {
+        server_protocol().wp_presentation_feedback_discarded (callback.second);
+        destroy_object (callback.second);
+      }
+      if (s->latched)
+      {
+        // never reaches the toplevel, the client gets its buffer back
+        if (s->latched->upload.valid())
+          server_protocol().wl_buffer_release (s->latched->buffer_id);
+        for (auto callback : s->latched->frame_callbacks)
+          destroy_object (callback);
+        for (auto callback : s->latched->presentation_feedbacks)
+        {
+          server_protocol().wp_presentation_feedback_discarded (callback);
+          destroy_object (callback);
+        }
+      }
+    }
+    if (focused_surface_id == surface_id)
+      focused_surface_id = 0;
+    if (old_focused_surface_id == surface_id)
+      old_focused_surface_id = 0;
+    if (last_surface_entered_id == surface_id)
+      last_surface_entered_id = 0;
+    destroy_object (surface_id);
+  }
   
   void wl_surface_attach (object& obj, std::uint32_t buffer_id, std::int32_t x, std::int32_t y)
   {
-    std::cout << "wl_surface_attach " << buffer_id << std::endl;
+    VWM_LOG (debug, wayland, "wl_surface_attach " << buffer_id);
     if (surface_type* s = std::get_if<surface_type>(&obj.data))
     {
       object_type buffer_obj = get_object(buffer_id);
@@ -984,7 +1122,7 @@ struct client
       }
       else if (dma_buffer* buffer = std::get_if<dma_buffer>(&buffer_obj.get().data))
       {
-        std::cout << "dma buffer" << std::endl;
+        VWM_LOG (debug, wayland, "dma buffer");
         static_cast<void>(buffer);
         // s->attach (std::move(*buffer), buffer_id, x, y);
       }
@@ -994,84 +1132,284 @@ struct client
   void wl_surface_damage (object& obj, std::int32_t, std::int32_t, std::int32_t, std::int32_t) {}
   void wl_surface_frame (object& obj, std::uint32_t new_id)
   {
-    std::cout << "frame throttling yet" << std::endl;
-
     add_object (new_id, {vwm::wayland::generated::interface_::empty});
-    server_protocol().wl_callback_done (new_id, serial++);
-    server_protocol().wl_display_delete_id (1, new_id);
+    if (surface_type* s = std::get_if<surface_type>(&obj.data))
+      s->pending_frame_callbacks.push_back (new_id);
   }
-  void wl_surface_set_opaque_region (object& obj, std::uint32_t) {}
-  void wl_surface_set_input_region (object& obj, std::uint32_t) {}
-  void wl_surface_commit (object& obj)
+
+  bool surface_visible (surface_type const& s) const
   {
-    if (surface_type* s = std::get_if<surface_type>(&obj.data))
+    auto const& extent = toplevel->window.voutput.swapChainExtent;
+    return s.render_token && s.width > 0 && s.height > 0
+      && s.pos_x < static_cast<std::int32_t>(extent.width)
+      && s.pos_y < static_cast<std::int32_t>(extent.height)
+      && s.pos_x + s.width > 0 && s.pos_y + s.height > 0;
+  }
+
+  // frame callbacks of visible surfaces are done once the frame drawing
+  // their commit is presented, hidden surfaces keep theirs
+  void frame_presented (vwm::presented_frame const& frame)
+  {
+    auto const time = std::chrono::duration_cast<std::chrono::milliseconds>
+      (frame.time.time_since_epoch()).count();
+    for (auto&& object : client_objects)
     {
-      if (shm_buffer** buffer = std::get_if <shm_buffer*>(&s->buffer))
+      if (auto* s = std::get_if<surface_type>(&object.data))
       {
-        std::cout << "calling draw buffer " << *buffer << std::endl;
+        if (s->frame_callbacks.empty() || !surface_visible (*s))
+          continue;
 
-        if ((*buffer))
+        auto last = s->frame_callbacks.begin();
+        for (;last != s->frame_callbacks.end() && last->first <= frame.scene; ++last)
         {
-          if (!s->render_token)
-          {
-            std::unique_lock <std::mutex> l(*render_mutex);
-            std::cout << "adding to image draw list" << std::endl;
-            auto value = s->load_token.get().image_view;
-            s->loaded = true;
-            std::cout << "adding image from client to render" << std::endl;
-            auto iterator = toplevel->append_component
-              ({s->pos_x, s->pos_y, (*buffer)->width, (*buffer)->height, ftk::ui::image_component{value}});
-            s->render_token = iterator;
-          }
-          else
-          {
-            std::unique_lock <std::mutex> l(*render_mutex);
-            auto value = s->load_token.get().image_view;
-            s->loaded = true;
-            toplevel->replace_image_view (*s->render_token, value);
-          }
-          render_dirty ();
+          server_protocol().wl_callback_done (last->second, static_cast<std::uint32_t>(time));
+          destroy_object (last->second);
+        }
+        s->frame_callbacks.erase (s->frame_callbacks.begin(), last);
+      }
+    }
+  }
 
-          
-          if (s->failed)
-          {
-            std::cout << "failed" << std::endl;
-          }
-          else if (s->loaded)
+  // a surface that is not visible when its frame is presented was not
+  // seen, so its feedbacks are discarded. So are the ones of commits
+  // replaced by a later commit before any frame drew them
+  void presentation_presented (vwm::presented_frame const& frame)
+  {
+    auto const time = std::chrono::duration_cast<std::chrono::nanoseconds>
+      (frame.time.time_since_epoch()).count();
+    std::uint64_t const seconds = time / 1000000000;
+    // a predicted time is neither vsync nor hardware clock accurate
+    std::uint32_t const flags = frame.exact ? 0x1 /* vsync */ | 0x2 /* hw_clock */ | 0x4 /* hw_completion */ : 0;
+
+    for (auto&& object : client_objects)
+    {
+      if (auto* s = std::get_if<surface_type>(&object.data))
+      {
+        bool const visible = surface_visible (*s);
+        auto last = s->presentation_feedbacks.begin();
+        while (last != s->presentation_feedbacks.end() && last->first <= frame.scene)
+          ++last;
+        auto const shown = last == s->presentation_feedbacks.begin() ? 0 : std::prev (last)->first;
+        for (auto it = s->presentation_feedbacks.begin(); it != last; ++it)
+        {
+          if (visible && it->first == shown)
           {
-            auto surface_id = get_object_id(&obj);
-        
-            server_protocol().wl_buffer_release (s->buffer_id);
-            if (output_id && last_surface_entered_id != surface_id)
-            {
-              last_surface_entered_id = surface_id;
-              server_protocol().wl_surface_enter (surface_id, output_id);
-            }
-            if (focused_surface_id && keyboard_id && old_focused_surface_id != focused_surface_id)
-            {
-              old_focused_surface_id = focused_surface_id;
-              array<uint32_t> keys;
-              server_protocol().wl_keyboard_enter (keyboard_id, serial++, focused_surface_id, keys);
-            }
+            if (output_id)
+              server_protocol().wp_presentation_feedback_sync_output (it->second, output_id);
+            server_protocol().wp_presentation_feedback_presented
+              (it->second, seconds >> 32, seconds & 0xFFFFFFFF, time % 1000000000
+               , frame.refresh.count(), frame.msc >> 32, frame.msc & 0xFFFFFFFF, flags);
           }
           else
-          {
-            std::cout << "not loaded yet" << std::endl;
-          }
+            server_protocol().wp_presentation_feedback_discarded (it->second);
+          destroy_object (it->second);
+        }
+        s->presentation_feedbacks.erase (s->presentation_feedbacks.begin(), last);
+      }
+    }
+  }
+  void wl_surface_set_opaque_region (object& obj, std::uint32_t region_id)
+  {
+    if (surface_type* s = std::get_if<surface_type>(&obj.data))
+    {
+      s->pending_opaque.clear();
+      if (region_id)
+        if (vwm::region* region = std::get_if<vwm::region>(&get_object (region_id).get().data))
+          s->pending_opaque = *region;
+    }
+  }
+  void wl_surface_set_input_region (object& obj, std::uint32_t) {}
+  // buffers without alpha cover the whole surface whatever opaque
+  // region the client set, so they occlude what is below them
+  static vwm::region committed_opaque_region (surface_type const& s, shm_buffer const& buffer)
+  {
+    if (!format_has_alpha (buffer.format))
+      return vwm::region (vwm::rect{0, 0, buffer.width, buffer.height});
+    return s.pending_opaque;
+  }
+
+  // the loop thread never waits for an upload or for the frames in
+  // use, a commit whose buffer is still uploading or that finds the
+  // scene gate held is latched, and applied once the upload is done
+  // and the gate dispatches
+  void wl_surface_commit (object& obj)
+  {
+    if (surface_type* s = std::get_if<surface_type>(&obj.data))
+    {
+      // the opaque region is latched by every commit, with or without
+      // a new buffer
+      surface_commit commit {s->buffer_id, 0, 0, {}, {}, s->pending_opaque
+                             , std::move (s->pending_frame_callbacks)
+                             , std::move (s->pending_presentation_feedbacks)};
+      s->pending_frame_callbacks.clear();
+      s->pending_presentation_feedbacks.clear();
+
+      if (shm_buffer** buffer = std::get_if <shm_buffer*>(&s->buffer))
+      {
+        VWM_LOG (debug, wayland, "calling draw buffer " << *buffer);
+
+        if (*buffer)
+        {
+          commit.width = (*buffer)->width;
+          commit.height = (*buffer)->height;
+          commit.opaque = committed_opaque_region (*s, **buffer);
+          if (s->load_token.valid())
+            commit.upload = s->load_token.share();
         }
       }
       else if (dma_buffer* buffer = std::get_if<dma_buffer>(&s->buffer))
       {
-        std::cout << "dma buffer commit" << std::endl;
+        VWM_LOG (debug, wayland, "dma buffer commit");
 
         // ftk::ui::backend::draw_buffer (*backend, *toplevel, buffer->params[0].fd, buffer->width
         //                                , buffer->height, buffer->format, buffer->params[0].offset, buffer->params[0].stride
         //                                , buffer->params[0].modifier_hi, buffer->params[0].modifier_lo);
       }
+
+      if (s->latched)
+      {
+        auto& earlier = *s->latched;
+        commit.frame_callbacks.insert (commit.frame_callbacks.begin(), earlier.frame_callbacks.begin()
+                                       , earlier.frame_callbacks.end());
+        if (commit.upload.valid())
+        {
+          // the earlier buffer is never shown
+          server_protocol().wl_buffer_release (earlier.buffer_id);
+          for (auto callback : earlier.presentation_feedbacks)
+          {
+            server_protocol().wp_presentation_feedback_discarded (callback);
+            destroy_object (callback);
+          }
+        }
+        else
+        {
+          // no new buffer, the earlier one is still this commit's content
+          commit.buffer_id = earlier.buffer_id;
+          commit.width = earlier.width;
+          commit.height = earlier.height;
+          commit.upload = std::move (earlier.upload);
+          commit.uploaded = std::move (earlier.uploaded);
+          commit.presentation_feedbacks.insert (commit.presentation_feedbacks.begin()
+                                                , earlier.presentation_feedbacks.begin()
+                                                , earlier.presentation_feedbacks.end());
+        }
+        s->latched.reset();
+      }
+
+      if (commit.upload.valid() && !commit.upload.is_ready())
+      {
+        VWM_LOG (debug, wayland, "not loaded yet");
+        if (!commit.uploaded.valid())
+          commit.uploaded = commit.upload.then
+            ([uploads_done = uploads_done] (pc::shared_future<ftk::ui::backend::vulkan_image> const&)
+             {
+               uploads_done->notify();
+             });
+        s->latched = std::move (commit);
+      }
+      else if (!gate->try_lock())
+        s->latched = std::move (commit);
+      else
+      {
+        std::unique_lock<vwm::scene_gate> changing (*gate, std::adopt_lock);
+        apply_commit (obj, *s, std::move (commit));
+      }
     }
     else
     {
-      std::cout << "no surface?" << std::endl;
+      VWM_LOG (warning, wayland, "no surface?");
+    }
+  }
+
+  // with the gate held, no frame in use draws the component while it
+  // changes
+  void apply_commit (object& obj, surface_type& s, surface_commit commit)
+  {
+    // one scene per commit, pushed after the buffer reached the
+    // toplevel, so the frame drawing it has this commit
+    std::uint64_t scene = 0;
+    bool const opaque_changed = s.opaque != commit.opaque;
+    s.opaque = std::move (commit.opaque);
+    if (commit.upload.valid())
+    {
+      auto const value = commit.upload.get().image_view;
+      s.loaded = true;
+      if (!s.render_token)
+      {
+        VWM_LOG (debug, wayland, "adding image from client to render");
+        s.render_token = toplevel->append_component
+          ({s.pos_x, s.pos_y, commit.width, commit.height, ftk::ui::image_component{value}});
+      }
+      else
+        toplevel->replace_image_view (*s.render_token, value);
+      opaque_regions->set (&**s.render_token, s.opaque);
+      s.width = commit.width;
+      s.height = commit.height;
+      scene = render_dirty ();
+
+      if (s.failed)
+      {
+        VWM_LOG (error, wayland, "failed");
+      }
+      else
+      {
+        auto surface_id = get_object_id(&obj);
+
+        server_protocol().wl_buffer_release (commit.buffer_id);
+        if (output_id && last_surface_entered_id != surface_id)
+        {
+          last_surface_entered_id = surface_id;
+          server_protocol().wl_surface_enter (surface_id, output_id);
+        }
+        if (focused_surface_id && keyboard_id && old_focused_surface_id != focused_surface_id)
+        {
+          old_focused_surface_id = focused_surface_id;
+          array<uint32_t> keys;
+          server_protocol().wl_keyboard_enter (keyboard_id, serial++, focused_surface_id, keys);
+        }
+      }
+    }
+    // a commit changing only the opaque region changes what is culled
+    else if (s.render_token && opaque_changed)
+    {
+      opaque_regions->set (&**s.render_token, s.opaque);
+      scene = render_dirty ();
+    }
+
+    // callbacks of a commit without a buffer still wait for a frame
+    if (!commit.frame_callbacks.empty() || !commit.presentation_feedbacks.empty())
+    {
+      if (!scene)
+        scene = render_dirty ();
+      for (auto callback : commit.frame_callbacks)
+        s.frame_callbacks.push_back ({scene, callback});
+      for (auto callback : commit.presentation_feedbacks)
+        s.presentation_feedbacks.push_back ({scene, callback});
+    }
+  }
+
+  // loop thread with the gate held, after the uploads of latched
+  // commits or the frames holding the gate are done
+  void apply_latched_commits ()
+  {
+    for (auto&& object : client_objects)
+    {
+      auto* s = std::get_if<surface_type>(&object.data);
+      if (!s || !s->latched
+          || (s->latched->upload.valid() && !s->latched->upload.is_ready()))
+        continue;
+      auto commit = std::move (*s->latched);
+      s->latched.reset();
+      try
+      {
+        apply_commit (object, *s, std::move (commit));
+      }
+      catch (std::exception const& e)
+      {
+        // a broken connection is dropped when its socket is read
+        VWM_LOG (error, wayland, "Error applying latched commit: " << e.what());
+        s->failed = true;
+      }
     }
   }
   void wl_surface_set_buffer_transform (object& obj, std::int32_t) {}
@@ -1083,7 +1421,7 @@ struct client
   }
   void wl_seat_get_keyboard (object& obj, std::uint32_t new_id)
   {
-    std::cout << "wl_seat_get_keyboard new_id " << new_id << std::endl;
+    VWM_LOG (debug, wayland, "wl_seat_get_keyboard new_id " << new_id);
     
     add_object (new_id, {vwm::wayland::generated::interface_::wl_pointer});
     keyboard_id = new_id;
@@ -1097,14 +1435,14 @@ struct client
       void* p = ::mmap (NULL, strlen(keymap_string), PROT_WRITE, MAP_SHARED, fd, 0);
       memcpy (p, keymap_string, strlen(keymap_string));
 
-      std::cout << "sending keymap" << std::endl;
+      VWM_LOG (debug, wayland, "sending keymap");
       server_protocol().wl_keyboard_keymap (new_id, 1 /* XKB_V1 */, fd, strlen(keymap_string));
-      std::cout << "sent keymap" << std::endl;
+      VWM_LOG (debug, wayland, "sent keymap");
     }
   }
   void send_key (std::uint32_t time, std::uint32_t key, std::uint32_t state)
   {
-    std::cout << " keyboard id "  << keyboard_id << std::endl;
+    VWM_LOG (debug, wayland, " keyboard id "  << keyboard_id);
     if (keyboard_id)
     {
       server_protocol().wl_keyboard_key (keyboard_id, serial, time, key, state);
@@ -1123,9 +1461,20 @@ struct client
   void wl_keyboard_release (object& obj) {}
   void wl_touch_release (object& obj) {}
   void wl_output_release (object& obj) {}
-  void wl_region_destroy (object& obj) {}
-  void wl_region_add (object& obj, std::int32_t, std::int32_t, std::int32_t, std::int32_t) {}
-  void wl_region_subtract (object& obj, std::int32_t, std::int32_t, std::int32_t, std::int32_t) {}
+  void wl_region_destroy (object& obj)
+  {
+    destroy_object (get_object_id (&obj));
+  }
+  void wl_region_add (object& obj, std::int32_t x, std::int32_t y, std::int32_t width, std::int32_t height)
+  {
+    if (vwm::region* region = std::get_if<vwm::region>(&obj.data))
+      region->unite (vwm::rect{x, y, width, height});
+  }
+  void wl_region_subtract (object& obj, std::int32_t x, std::int32_t y, std::int32_t width, std::int32_t height)
+  {
+    if (vwm::region* region = std::get_if<vwm::region>(&obj.data))
+      region->subtract (vwm::rect{x, y, width, height});
+  }
   void wl_subcompositor_destroy (object& obj) {}
   void wl_subcompositor_get_subsurface (object& obj, std::uint32_t new_id, std::uint32_t surface, std::uint32_t parent)
   {
@@ -1181,6 +1530,13 @@ struct client
   void xdg_popup_destroy(object& obj) {}
   void xdg_popup_grab(object& obj, std::uint32_t arg0, std::uint32_t arg1) {}
 
+  void wp_presentation_destroy (object& obj) {}
+  void wp_presentation_feedback (object& obj, std::uint32_t surface, std::uint32_t callback)
+  {
+    add_object (callback, {vwm::wayland::generated::interface_::wp_presentation_feedback});
+    if (surface_type* s = std::get_if<surface_type>(&get_object (surface).get().data))
+      s->pending_presentation_feedbacks.push_back (callback);
+  }
   void zwp_linux_dmabuf_v1_destroy (object& obj) {}
   void zwp_linux_dmabuf_v1_create_params (object& obj, std::uint32_t new_id)
   {
@@ -1201,7 +1557,7 @@ struct client
   void zwp_linux_buffer_params_v1_create_immed(object& obj, std::uint32_t new_id, std::int32_t width, std::int32_t height
                                                , std::uint32_t format, std::uint32_t flags)
   {
-    std::cout << "zwp_linux_buffer_params_v1_create_immed " << new_id << " " << width << " " << height << " format " << format << " " << flags <<std::endl;
+    VWM_LOG (debug, wayland, "zwp_linux_buffer_params_v1_create_immed " << new_id << " " << width << " " << height << " format " << format << " " << flags);
     if (wayland::dma_params* params = std::get_if<wayland::dma_params>(&obj.data))
     {
       add_object (new_id, {wayland::generated::interface_::wl_buffer, {wayland::dma_buffer{width, height, format, flags, params->params}}});
@@ -1216,7 +1572,7 @@ struct client
 
   void wl_drm_authenticate(object& obj, std::uint32_t magic)
   {
-    std::cout << "wl_drm_authenticate with magic " << magic << std::endl;
+    VWM_LOG (debug, wayland, "wl_drm_authenticate with magic " << magic);
     if (struct drm* drm = std::get_if<struct drm>(&obj.data))
     {
       ::ioctl(drm->fd, DRM_IOCTL_AUTH_MAGIC, &magic);
@@ -74,6 +74,23 @@ enum class format
  , yvu444 = 0x34325659
 };
 
+// formats without an alpha channel are opaque by definition
+inline bool format_has_alpha (format f)
+{
+  switch (f)
+  {
+  case format::argb8888: case format::argb4444: case format::abgr4444:
+  case format::rgba4444: case format::bgra4444: case format::argb1555:
+  case format::abgr1555: case format::rgba5551: case format::bgra5551:
+  case format::abgr8888: case format::rgba8888: case format::bgra8888:
+  case format::argb2101010: case format::abgr2101010: case format::rgba1010102:
+  case format::bgra1010102: case format::ayuv:
+    return true;
+  default:
+    return false;
+  };
+}
+
 const char* format_description (format f)
 {
   switch (f)
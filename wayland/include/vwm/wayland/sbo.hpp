@@ -10,6 +10,8 @@
 #ifndef VWM_WAYLAND_SBO_HPP
 #define VWM_WAYLAND_SBO_HPP
 
+#include <vwm/log.hpp>
+
 #include <vector>
 #include <cstddef>
 
@@ -70,7 +72,7 @@ struct sbo
   {
     if (is_dynamic())
     {
-      std::cout << "is_dynamic" << std::endl;
+      VWM_LOG (debug, wayland, "is_dynamic");
       auto db = get_dynamic_buffer();
       db->v.resize(size);
     }
@@ -12,12 +12,20 @@
 
 #include <vwm/wayland/shm.hpp>
 #include <vwm/wayland/dmabuf.hpp>
+#include <vwm/region.hpp>
+
+#include <optional>
+#include <vector>
+#include <utility>
+#include <cstdint>
 
 namespace vwm { namespace wayland {
 
-template <typename LoadToken, typename RenderToken>
+template <typename LoadToken, typename RenderToken, typename Commit>
 struct surface
 {
+  typedef RenderToken render_token_type;
+
   std::size_t buffer_id;
   std::variant<shm_buffer*, dma_buffer> buffer = nullptr;
   LoadToken load_token;
@@ -25,6 +33,22 @@ struct surface
   bool failed = false;
   std::optional<RenderToken> render_token;
   std::int32_t pos_x, pos_y;
+  // size of the buffer last committed
+  std::int32_t width = 0, height = 0;
+  // opaque region set by the client and the one last committed, in
+  // surface coordinates
+  vwm::region pending_opaque, opaque;
+  // wl_callback ids requested with wl_surface.frame since the last
+  // commit
+  std::vector<std::uint32_t> pending_frame_callbacks;
+  // committed wl_callback ids with the scene of their commit
+  std::vector<std::pair<std::uint64_t, std::uint32_t>> frame_callbacks;
+  // wp_presentation_feedback ids, kept the same way as frame callbacks
+  std::vector<std::uint32_t> pending_presentation_feedbacks;
+  std::vector<std::pair<std::uint64_t, std::uint32_t>> presentation_feedbacks;
+  // last commit, while its buffer is still uploading or frames use
+  // the scene
+  std::optional<Commit> latched;
 
   surface (std::int32_t pos_x, std::int32_t pos_y)
     : pos_x(pos_x), pos_y(pos_y) {}
@@ -11,6 +11,7 @@
 #define VWM_WAYLAND_TYPES_HPP
 
 #include <vwm/wayland/sbo.hpp>
+#include <vwm/log.hpp>
 
 namespace vwm { namespace wayland {
 
@@ -104,7 +105,7 @@ std::size_t marshall_size (std::string_view v)
 {
   std::size_t rest = (v.size() + 1) % sizeof(std::uint32_t);
   auto r = sizeof (std::uint32_t) + v.size() + 1 + (rest == 0 ? 0 : sizeof(std::uint32_t) - rest);
-  std::cout << "marshall size for string " << v << " is " << r << std::endl;
+  VWM_LOG (trace, wayland, "marshall size for string " << v << " is " << r);
   return r;
 }
 std::size_t marshall_size (array_base const& v)
@@ -148,7 +149,7 @@ template <typename F, typename...T>
 void send_with_fds (int sock, void* buffer, std::size_t length
                     , F fd, T...fds)
 {
-  std::cout << "sending file descriptor " << fd << " plus " << sizeof...(fds) << " file descriptors" << std::endl;
+  VWM_LOG (trace, wayland, "sending file descriptor " << fd << " plus " << sizeof...(fds) << " file descriptors");
   
   //ssize_t size;
   char control[CMSG_SPACE(sizeof(int32_t) + 1 + sizeof...(fds))];
@@ -176,7 +177,7 @@ void send_with_fds (int sock, void* buffer, std::size_t length
   
   int r = sendmsg (sock, &message, 0);
 
-  std::cout << "sent " << r << std::endl;
+  VWM_LOG (trace, wayland, "sent " << r);
 
   if (r < 0)
   {